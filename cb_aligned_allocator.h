@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// std allocator handing out storage aligned to Alignment bytes
+template<class T, size_t Alignment>
+struct AlignedAllocator
+{
+        using value_type = T;
+        template<class U>
+        struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+        AlignedAllocator() = default;
+        template<class U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        T* allocate(size_t n)
+        {
+                return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ Alignment }));
+        }
+        void deallocate(T* ptr, size_t) noexcept
+        {
+                ::operator delete(ptr, std::align_val_t{ Alignment });
+        }
+        template<class U>
+        bool operator==(const AlignedAllocator<U, Alignment>&)const noexcept { return true; }
+        template<class U>
+        bool operator!=(const AlignedAllocator<U, Alignment>&)const noexcept { return false; }
+};
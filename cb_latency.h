@@ -0,0 +1,212 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <emmintrin.h>
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// opt-in per operation latency, turned on with --latency_histograms[=file].
+// each operation is bracketed by fenced rdtsc reads and the cost of an
+// empty bracket, calibrated once, is taken off every sample
+inline std::string LatencyDumpPath;
+
+struct Tsc
+{
+        static uint64_t start()
+        {
+                _mm_lfence();
+                const auto t = __rdtsc();
+                _mm_lfence();
+                return t;
+        }
+        static uint64_t stop()
+        {
+                unsigned aux;
+                const auto t = __rdtscp(&aux);
+                _mm_lfence();
+                return t;
+        }
+
+        // median of many empty brackets
+        static uint64_t overheadCycles()
+        {
+                static const uint64_t overhead = [] {
+                        std::vector<uint64_t> samples(1 << 14);
+                        for (auto& sample : samples)
+                        {
+                                const auto t0 = start();
+                                sample = stop() - t0;
+                        }
+                        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+                        return samples[samples.size() / 2];
+                }();
+                return overhead;
+        }
+
+        static double nsPerCycle()
+        {
+                static const double ratio = [] {
+                        const auto wall0 = std::chrono::steady_clock::now();
+                        const auto tsc0 = start();
+                        while (std::chrono::steady_clock::now() - wall0 < std::chrono::milliseconds(20))
+                        {
+                        }
+                        const auto tsc1 = stop();
+                        const auto wall1 = std::chrono::steady_clock::now();
+                        return std::chrono::duration<double, std::nano>(wall1 - wall0).count() / static_cast<double>(tsc1 - tsc0);
+                }();
+                return ratio;
+        }
+};
+
+// hdr style log-linear buckets, values below 2^SubBucketBits are exact and
+// above that every power of two is split into 2^SubBucketBits buckets, so
+// the relative error stays around 3%
+class LatencyHistogram
+{
+public:
+        static constexpr unsigned SubBucketBits = 5;
+        static constexpr uint64_t SubBuckets = uint64_t(1) << SubBucketBits;
+
+        void record(uint64_t cycles)
+        {
+                ++counts_[bucketOf(cycles)];
+                ++total_;
+                max_ = std::max(max_, cycles);
+        }
+
+        uint64_t count()const { return total_; }
+        uint64_t max()const { return max_; }
+
+        // the upper edge of the bucket holding the p'th fraction of samples
+        uint64_t percentile(double p)const
+        {
+                const auto rank = static_cast<uint64_t>(std::ceil(p * static_cast<double>(total_)));
+                uint64_t seen = 0;
+                for (size_t bucket = 0; bucket != counts_.size(); ++bucket)
+                {
+                        seen += counts_[bucket];
+                        if (seen >= rank && seen != 0)
+                        {
+                                return std::min(upperOf(bucket), max_);
+                        }
+                }
+                return max_;
+        }
+
+        template<class F>
+        void forEachBucket(F&& f)const
+        {
+                for (size_t bucket = 0; bucket != counts_.size(); ++bucket)
+                {
+                        if (counts_[bucket] != 0)
+                        {
+                                f(upperOf(bucket), counts_[bucket]);
+                        }
+                }
+        }
+private:
+        static size_t bucketOf(uint64_t value)
+        {
+                if (value < SubBuckets)
+                {
+                        return static_cast<size_t>(value);
+                }
+                const auto shift = static_cast<unsigned>(std::bit_width(value)) - 1 - SubBucketBits;
+                return static_cast<size_t>((shift + 1) * SubBuckets + ((value >> shift) - SubBuckets));
+        }
+        static uint64_t upperOf(size_t bucket)
+        {
+                if (bucket < SubBuckets)
+                {
+                        return bucket;
+                }
+                const auto shift = static_cast<unsigned>(bucket / SubBuckets) - 1;
+                const auto sub = bucket % SubBuckets + SubBuckets;
+                return ((sub + 1) << shift) - 1;
+        }
+
+        std::array<uint64_t, (64 - SubBucketBits + 1) * SubBuckets> counts_{};
+        uint64_t total_ = 0;
+        uint64_t max_ = 0;
+};
+
+template<class F>
+inline void timeOperation(LatencyHistogram& histogram, F&& op)
+{
+        const auto t0 = Tsc::start();
+        op();
+        const auto elapsed = Tsc::stop() - t0;
+        const auto overhead = Tsc::overheadCycles();
+        histogram.record(elapsed > overhead ? elapsed - overhead : 0);
+}
+
+// percentiles go out as counters in ns. google benchmark reruns a benchmark
+// while it works out the iteration count, so only the last histogram for
+// each name is kept and the whole set is dumped after the run
+inline std::map<std::string, LatencyHistogram> LatencyResults;
+
+inline void reportLatency(benchmark::State& state, const LatencyHistogram& histogram, const std::string& name)
+{
+        const auto ns = Tsc::nsPerCycle();
+        state.counters["p50_ns"] = static_cast<double>(histogram.percentile(0.5)) * ns;
+        state.counters["p90_ns"] = static_cast<double>(histogram.percentile(0.9)) * ns;
+        state.counters["p99_ns"] = static_cast<double>(histogram.percentile(0.99)) * ns;
+        state.counters["p999_ns"] = static_cast<double>(histogram.percentile(0.999)) * ns;
+        state.counters["max_ns"] = static_cast<double>(histogram.max()) * ns;
+        state.counters["overhead_cycles"] = static_cast<double>(Tsc::overheadCycles());
+        LatencyResults[name] = histogram;
+}
+
+// name,upper_ns,count lines to the dump file, or stderr without one
+inline void writeLatencyDump()
+{
+        std::ofstream file;
+        if (!LatencyDumpPath.empty())
+        {
+                file.open(LatencyDumpPath);
+        }
+        std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cerr;
+        const auto ns = Tsc::nsPerCycle();
+        out << "# overhead_cycles=" << Tsc::overheadCycles() << " ns_per_cycle=" << ns << "\n";
+        out << "name,upper_ns,count\n";
+        for (const auto& [name, histogram] : LatencyResults)
+        {
+                histogram.forEachBucket([&](uint64_t upper, uint64_t count) {
+                        out << name << "," << static_cast<double>(upper) * ns << "," << count << "\n"; });
+        }
+}
+
+// takes --latency_histograms[=file] out of args, true if it was there
+inline bool takeLatencyHistogramsFlag(std::vector<char*>& args)
+{
+        static constexpr char Flag[] = "--latency_histograms";
+        static constexpr size_t FlagLength = sizeof(Flag) - 1;
+        const auto flag = std::find_if(args.begin(), args.end(), [](const char* arg) {
+                return std::strncmp(arg, Flag, FlagLength) == 0 && (arg[FlagLength] == '\0' || arg[FlagLength] == '='); });
+        if (flag == args.end())
+        {
+                return false;
+        }
+        if ((*flag)[FlagLength] == '=')
+        {
+                LatencyDumpPath = *flag + FlagLength + 1;
+        }
+        args.erase(flag);
+        return true;
+}
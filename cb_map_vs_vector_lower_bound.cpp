@@ -10,9 +10,169 @@
 #include <iterator>
 #include <array>
 #include <memory_resource>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <tuple>
+#include <cstdint>
+#include <numeric>
+#include <limits>
+#include <bit>
+#include <new>
+#include <cstring>
+#include <stdexcept>
+#include <cstddef>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
+#include "cb_aligned_allocator.h"
+#include "cb_latency.h"
+#include "cb_perf_counters.h"
 
 
+
+// bump allocator over one big reservation of address space, pages are
+// committed as it grows so a billion key fixture doesn't need a buffer
+// sized up front. deallocate only counts, once everything handed out has
+// been given back the arena rewinds, so building fixtures over and over
+// (like the *Fresh benchmarks) reuses the same pages. past RetainBytes the
+// pages are handed back to the os on rewind
+class ArenaResource : public std::pmr::memory_resource
+{
+public:
+        static constexpr size_t DefaultReserve = size_t(1) << 38;
+        static constexpr size_t RetainBytes = size_t(1) << 26;
+        static constexpr size_t MinCommit = size_t(1) << 21;
+
+        explicit ArenaResource(size_t reserve = DefaultReserve)
+                : reserved_(reserve)
+        {
+#ifdef _WIN32
+                base_ = static_cast<std::byte*>(VirtualAlloc(nullptr, reserved_, MEM_RESERVE, PAGE_NOACCESS));
+                if (base_ == nullptr)
+                {
+                        throw std::bad_alloc();
+                }
+#else
+                void* ptr = mmap(nullptr, reserved_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (ptr == MAP_FAILED)
+                {
+                        throw std::bad_alloc();
+                }
+                base_ = static_cast<std::byte*>(ptr);
+#endif
+        }
+        ArenaResource(const ArenaResource&) = delete;
+        ArenaResource& operator=(const ArenaResource&) = delete;
+        ~ArenaResource()
+        {
+#ifdef _WIN32
+                VirtualFree(base_, 0, MEM_RELEASE);
+#else
+                munmap(base_, reserved_);
+#endif
+        }
+
+        size_t used()const { return top_; }
+        size_t committed()const { return committed_; }
+
+        // everything allocated so far is dead after this
+        void reset()
+        {
+                top_ = 0;
+                live_ = 0;
+                if (committed_ > RetainBytes)
+                {
+                        decommit(RetainBytes, committed_ - RetainBytes);
+                        committed_ = RetainBytes;
+                }
+        }
+private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+                const size_t first = (top_ + alignment - 1) & ~(alignment - 1);
+                const size_t last = first + bytes;
+                if (last > reserved_)
+                {
+                        throw std::bad_alloc();
+                }
+                if (last > committed_)
+                {
+                        commit(last);
+                }
+                top_ = last;
+                ++live_;
+                return base_ + first;
+        }
+        void do_deallocate(void*, size_t, size_t) override
+        {
+                if (--live_ == 0)
+                {
+                        reset();
+                }
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+        {
+                return this == &other;
+        }
+
+        // at least doubles, so growing to n bytes takes log(n) system calls
+        void commit(size_t needed)
+        {
+                size_t target = std::max({ needed, committed_ * 2, MinCommit });
+                target = std::min((target + MinCommit - 1) & ~(MinCommit - 1), reserved_);
+#ifdef _WIN32
+                if (VirtualAlloc(base_ + committed_, target - committed_, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+                {
+                        throw std::bad_alloc();
+                }
+#else
+                if (mprotect(base_ + committed_, target - committed_, PROT_READ | PROT_WRITE) != 0)
+                {
+                        throw std::bad_alloc();
+                }
+#endif
+                committed_ = target;
+        }
+        void decommit(size_t offset, size_t bytes)
+        {
+#ifdef _WIN32
+                VirtualFree(base_ + offset, bytes, MEM_DECOMMIT);
+#else
+                madvise(base_ + offset, bytes, MADV_DONTNEED);
+                mprotect(base_ + offset, bytes, PROT_NONE);
+#endif
+        }
+
+        std::byte* base_ = nullptr;
+        size_t reserved_;
+        size_t committed_ = 0;
+        size_t top_ = 0;
+        size_t live_ = 0;
+};
+
+// shared by every pmr fixture, it rewinds once they are all destroyed
+static ArenaResource& fixturePool()
+{
+        static ArenaResource pool;
+        return pool;
+}
+
 template<size_t ValueSize>
 std::tuple<
         std::vector<int64_t>,
@@ -20,160 +180,2723 @@ std::tuple<
         std::map<int64_t, std::array<std::byte, ValueSize>>,
         std::pmr::map<int64_t, std::array<std::byte, ValueSize>>> makeMapAndIndex(int64_t size)
 {
-        constexpr size_t buffer_size = 1024 * 1024 * 16;
-        static std::vector<std::byte> buf(buffer_size);
-        static std::pmr::monotonic_buffer_resource pool{ buf.data(), buf.size(), std::pmr::null_memory_resource() };
+        std::map<int64_t, std::array<std::byte, ValueSize>> M;
+        std::pmr::map<int64_t, std::array<std::byte, ValueSize>> pmrM(&fixturePool());
+        std::vector < std::pair<int64_t, std::array<std::byte, ValueSize> > > V;
+        std::vector<int64_t> index;
+        V.reserve(static_cast<size_t>(size));
+        index.reserve(static_cast<size_t>(size));
+
+        std::array<std::byte, ValueSize> dummy_value;
+        for (int64_t iter = 0; iter != size; ++iter)
+        {
+                M.emplace(iter, dummy_value);
+                pmrM.emplace(iter, dummy_value);
+                V.emplace_back(iter, dummy_value);
+                index.push_back(iter);
+        }
+
+        std::random_device rd;
+        std::mt19937 g(rd());
+        std::shuffle(index.begin(), index.end(), g);
+        return std::make_tuple(std::move(index), std::move(V), std::move(M), std::move(pmrM));
+}
+
+
+// makeMapAndIndex builds every structure at once, which doesn't fit in
+// memory at 100M keys. the large fixtures only build the one being measured
+// and look up a fixed number of random keys per iteration
+constexpr size_t LayoutLookups = 1 << 16;
+
+// every key once in shuffled order, or past LayoutLookups keys that many
+// random ones, so the index doesn't grow with the fixture
+static std::vector<int64_t> makeLookupIndex(int64_t size)
+{
+        std::random_device rd;
+        std::mt19937 g(rd());
+        if (static_cast<size_t>(size) <= LayoutLookups)
+        {
+                std::vector<int64_t> index(static_cast<size_t>(size));
+                std::iota(index.begin(), index.end(), 0);
+                std::shuffle(index.begin(), index.end(), g);
+                return index;
+        }
+        std::vector<int64_t> index(LayoutLookups);
+        std::uniform_int_distribution<int64_t> dist(0, size - 1);
+        std::generate(index.begin(), index.end(), [&]() { return dist(g); });
+        return index;
+}
+
+template<size_t ValueSize>
+std::vector<std::pair<int64_t, std::array<std::byte, ValueSize> > > makeSortedVector(int64_t size)
+{
+        std::vector<std::pair<int64_t, std::array<std::byte, ValueSize> > > V(static_cast<size_t>(size));
+        for (int64_t iter = 0; iter != size; ++iter)
+        {
+                V[static_cast<size_t>(iter)].first = iter;
+        }
+        return V;
+}
+
+template<size_t ValueSize>
+std::map<int64_t, std::array<std::byte, ValueSize> > makeStdMap(int64_t size)
+{
+        std::map<int64_t, std::array<std::byte, ValueSize> > M;
+        const std::array<std::byte, ValueSize> value{};
+        for (int64_t iter = 0; iter != size; ++iter)
+        {
+                M.emplace_hint(M.end(), iter, value);
+        }
+        return M;
+}
+
+template<size_t ValueSize>
+std::pmr::map<int64_t, std::array<std::byte, ValueSize> > makePmrMap(int64_t size)
+{
+        std::pmr::map<int64_t, std::array<std::byte, ValueSize> > M(&fixturePool());
+        const std::array<std::byte, ValueSize> value{};
+        for (int64_t iter = 0; iter != size; ++iter)
+        {
+                M.emplace_hint(M.end(), iter, value);
+        }
+        return M;
+}
+
+// sorted map with the keys and values in separate arrays, so a search only
+// touches the dense key array and the value is read once at the end. single
+// inserts are O(n), batches are sorted and merged in one pass
+template<class Key, class Value>
+class FlatMap
+{
+public:
+        FlatMap() = default;
+
+        // bulk build, the input doesn't need to be sorted. on duplicate keys
+        // the first one wins
+        template<class Iter>
+        static FlatMap build(Iter first, Iter last)
+        {
+                std::vector<std::pair<Key, Value> > items(first, last);
+                std::stable_sort(items.begin(), items.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+                FlatMap result;
+                result.keys_.reserve(items.size());
+                result.values_.reserve(items.size());
+                for (const auto& item : items)
+                {
+                        if (result.keys_.empty() || result.keys_.back() != item.first)
+                        {
+                                result.keys_.push_back(item.first);
+                                result.values_.push_back(item.second);
+                        }
+                }
+                return result;
+        }
+
+        // keys must already be sorted and unique, nothing is copied
+        static FlatMap fromSorted(std::vector<Key> keys, std::vector<Value> values)
+        {
+                FlatMap result;
+                result.keys_ = std::move(keys);
+                result.values_ = std::move(values);
+                return result;
+        }
+
+        size_t size()const { return keys_.size(); }
+        const std::vector<Key>& keys()const { return keys_; }
+        const std::vector<Value>& values()const { return values_; }
+
+        size_t lower_bound(const Key& key)const
+        {
+                return static_cast<size_t>(std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin());
+        }
+        const Value* find(const Key& key)const
+        {
+                const auto pos = lower_bound(key);
+                return pos != keys_.size() && keys_[pos] == key ? &values_[pos] : nullptr;
+        }
+
+        bool insert(const Key& key, const Value& value)
+        {
+                const auto pos = lower_bound(key);
+                if (pos != keys_.size() && keys_[pos] == key)
+                {
+                        return false;
+                }
+                keys_.insert(keys_.begin() + pos, key);
+                values_.insert(values_.begin() + pos, value);
+                return true;
+        }
+
+        // merges from the back so every existing element moves at most once.
+        // keys already present are left alone
+        void insert_batch(std::vector<std::pair<Key, Value> > batch)
+        {
+                std::sort(batch.begin(), batch.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+                batch.erase(std::unique(batch.begin(), batch.end(), [](const auto& l, const auto& r) { return l.first == r.first; }), batch.end());
+                batch.erase(std::remove_if(batch.begin(), batch.end(), [&](const auto& item) { return find(item.first) != nullptr; }), batch.end());
+                if (batch.empty())
+                {
+                        return;
+                }
+                size_t src = keys_.size();
+                size_t dst = keys_.size() + batch.size();
+                size_t pending = batch.size();
+                keys_.resize(dst);
+                values_.resize(dst);
+                while (pending != 0)
+                {
+                        const auto& item = batch[pending - 1];
+                        if (src != 0 && keys_[src - 1] > item.first)
+                        {
+                                --src;
+                                --dst;
+                                keys_[dst] = keys_[src];
+                                values_[dst] = values_[src];
+                        }
+                        else
+                        {
+                                --pending;
+                                --dst;
+                                keys_[dst] = item.first;
+                                values_[dst] = item.second;
+                        }
+                }
+        }
+
+        // one compaction pass from the first erased key, merging against the
+        // sorted batch. once the batch runs out the tail moves down in one go.
+        // returns the number of keys removed
+        size_t erase_batch(std::vector<Key> batch)
+        {
+                if (batch.empty())
+                {
+                        return 0;
+                }
+                std::sort(batch.begin(), batch.end());
+                size_t dst = lower_bound(batch.front());
+                size_t src = dst;
+                auto next = batch.begin();
+                while (src != keys_.size() && next != batch.end())
+                {
+                        if (*next < keys_[src])
+                        {
+                                ++next;
+                        }
+                        else if (*next == keys_[src])
+                        {
+                                ++src;
+                        }
+                        else
+                        {
+                                keys_[dst] = keys_[src];
+                                values_[dst] = values_[src];
+                                ++dst;
+                                ++src;
+                        }
+                }
+                std::move(keys_.begin() + src, keys_.end(), keys_.begin() + dst);
+                std::move(values_.begin() + src, values_.end(), values_.begin() + dst);
+                dst += keys_.size() - src;
+                const auto removed = keys_.size() - dst;
+                keys_.resize(dst);
+                values_.resize(dst);
+                return removed;
+        }
+private:
+        std::vector<Key> keys_;
+        std::vector<Value> values_;
+};
+
+// the mixed workloads insert or erase MixedInsertBatch keys then do
+// MixedLookupsPerBatch lookups, until size/4 keys are added or removed.
+// every flat batch moves the whole array, so past MixedMaxKeys the count
+// stops growing with the fixture
+constexpr size_t MixedInsertBatch = 16;
+constexpr size_t MixedLookupsPerBatch = 64;
+constexpr size_t MixedMaxKeys = 1 << 10;
+
+static size_t mixedKeyCount(int64_t size)
+{
+        return std::min(static_cast<size_t>(size / 4), MixedMaxKeys);
+}
+
+// keys size.. that aren't in the map yet, in shuffled order
+static std::vector<int64_t> makeNewKeys(int64_t size)
+{
+        std::vector<int64_t> keys(mixedKeyCount(size));
+        std::iota(keys.begin(), keys.end(), size);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937{ 42 });
+        return keys;
+}
+
+// keys 0..size-1 that are in the map, in shuffled order
+static std::vector<int64_t> makeEraseKeys(int64_t size)
+{
+        std::vector<int64_t> keys(static_cast<size_t>(size));
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937{ 42 });
+        keys.resize(mixedKeyCount(size));
+        return keys;
+}
+
+// keys 0..size-1 with zeroed values
+template<class Value>
+FlatMap<int64_t, Value> makeFlatMap(int64_t size)
+{
+        std::vector<int64_t> keys(static_cast<size_t>(size));
+        std::iota(keys.begin(), keys.end(), 0);
+        return FlatMap<int64_t, Value>::fromSorted(std::move(keys), std::vector<Value>(static_cast<size_t>(size)));
+}
+
+constexpr size_t CacheLineSize = 64;
+constexpr size_t KeysPerCacheLine = CacheLineSize / sizeof(int64_t);
+
+using CacheAlignedKeys = std::vector<int64_t, AlignedAllocator<int64_t, CacheLineSize> >;
+
+// prefetching a slot that may be past the end is fine, it never faults
+inline void prefetchKey(const int64_t* base, size_t slot)
+{
+        _mm_prefetch(reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(base) + slot * sizeof(int64_t)), _MM_HINT_T0);
+}
+
+// sorted keys laid out in bfs order, the children of slot k are 2k and
+// 2k+1 with slot 0 unused. the root is slot 1 so the 8 great-grandchildren
+// of a slot, 8k..8k+7, share a cache line, which is prefetched 3 levels
+// before it is needed
+class EytzingerIndex
+{
+public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        explicit EytzingerIndex(const std::vector<int64_t>& sorted)
+                : keys_(sorted.size() + 1)
+        {
+                size_t next = 0;
+                build(sorted, next, 1);
+        }
+
+        size_t size()const { return keys_.size() - 1; }
+        int64_t key(size_t slot)const { return keys_[slot]; }
+
+        // the slot of the first key not less than key, npos if there isn't one
+        size_t lower_bound(int64_t key)const
+        {
+                const auto n = size();
+                const int64_t* base = keys_.data();
+                size_t k = 1;
+                while (k <= n)
+                {
+                        prefetchKey(base, k * KeysPerCacheLine);
+                        k = 2 * k + (base[k] < key);
+                }
+                // the path went right after the answer every time it went left,
+                // so drop the trailing right turns and the last left turn
+                k >>= std::countr_one(k) + 1;
+                return k == 0 ? npos : k;
+        }
+private:
+        void build(const std::vector<int64_t>& sorted, size_t& next, size_t k)
+        {
+                if (k <= sorted.size())
+                {
+                        build(sorted, next, 2 * k);
+                        keys_[k] = sorted[next++];
+                        build(sorted, next, 2 * k + 1);
+                }
+        }
+
+        CacheAlignedKeys keys_;
+};
+
+// static b-tree where every node is one cache line of keys with an implicit
+// layout, the children of node k are k * (B + 1) + i + 1. a search touches
+// log_{B+1}(n) lines instead of log_2(n). the tail of the last node is padded
+// with max(), so keys have to be below that
+class STreeIndex
+{
+public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+        static constexpr size_t B = KeysPerCacheLine;
+        static constexpr int64_t Padding = std::numeric_limits<int64_t>::max();
+
+        explicit STreeIndex(const std::vector<int64_t>& sorted)
+                : nodes_((sorted.size() + B - 1) / B)
+                , keys_(nodes_ * B, Padding)
+        {
+                size_t next = 0;
+                build(sorted, next, 0);
+        }
+
+        size_t size()const { return keys_.size(); }
+        int64_t key(size_t slot)const { return keys_[slot]; }
+
+        size_t lower_bound(int64_t key)const
+        {
+                const int64_t* base = keys_.data();
+                size_t result = npos;
+                size_t k = 0;
+                while (k < nodes_)
+                {
+                        const int64_t* node = base + k * B;
+                        size_t i = 0;
+                        for (size_t j = 0; j != B; ++j)
+                        {
+                                i += node[j] < key;
+                        }
+                        if (i != B)
+                        {
+                                result = k * B + i;
+                        }
+                        k = child(k, i);
+                }
+                return result != npos && base[result] == Padding ? npos : result;
+        }
+private:
+        static size_t child(size_t k, size_t i) { return k * (B + 1) + i + 1; }
+
+        void build(const std::vector<int64_t>& sorted, size_t& next, size_t k)
+        {
+                if (k < nodes_)
+                {
+                        for (size_t i = 0; i != B; ++i)
+                        {
+                                build(sorted, next, child(k, i));
+                                if (next < sorted.size())
+                                {
+                                        keys_[k * B + i] = sorted[next++];
+                                }
+                        }
+                        build(sorted, next, child(k, B));
+                }
+        }
+
+        size_t nodes_;
+        CacheAlignedKeys keys_;
+};
+
+// the static layouts get the sorted keys on their own, with LayoutLookups
+// random lookups per iteration
+static std::tuple<std::vector<int64_t>, std::vector<int64_t> > makeSortedKeysAndIndex(int64_t size)
+{
+        std::vector<int64_t> keys(static_cast<size_t>(size));
+        std::iota(keys.begin(), keys.end(), 0);
+        std::vector<int64_t> index(LayoutLookups);
+        std::mt19937_64 g{ 42 };
+        std::uniform_int_distribution<int64_t> dist(0, size - 1);
+        std::generate(index.begin(), index.end(), [&]() { return dist(g); });
+        return std::make_tuple(std::move(index), std::move(keys));
+}
+
+// b+tree keeping the data in linked leaves of LeafKeys sorted entries. the
+// separator keys of an inner node fill exactly one cache line and are
+// padded with max(), so picking a child is a fixed width count that never
+// branches on the data. erase doesn't rebalance, a leaf can run down to
+// empty and is skipped by scans, the separators stay valid bounds either way
+template<class Value>
+class BPlusTree
+{
+public:
+        static constexpr size_t InnerKeys = KeysPerCacheLine;
+        static constexpr size_t LeafKeys = 32;
+private:
+        static constexpr int64_t Padding = std::numeric_limits<int64_t>::max();
+
+        struct alignas(CacheLineSize) Leaf
+        {
+                std::array<int64_t, LeafKeys> keys;
+                std::array<Value, LeafKeys> values;
+                size_t count = 0;
+                Leaf* next = nullptr;
+        };
+        struct alignas(CacheLineSize) Inner
+        {
+                Inner() { keys.fill(Padding); }
+
+                std::array<int64_t, InnerKeys> keys;
+                std::array<void*, InnerKeys + 1> children;
+                size_t count = 0;
+        };
+        struct Split
+        {
+                int64_t key;
+                void* right;
+        };
+public:
+        // a position in the leaf chain, advancing it is the range scan
+        class Cursor
+        {
+        public:
+                Cursor(const Leaf* leaf, size_t slot)
+                        : leaf_(leaf), slot_(slot)
+                {
+                        skipEmpty();
+                }
+                bool valid()const { return leaf_ != nullptr; }
+                int64_t key()const { return leaf_->keys[slot_]; }
+                const Value& value()const { return leaf_->values[slot_]; }
+                void advance()
+                {
+                        ++slot_;
+                        skipEmpty();
+                }
+        private:
+                void skipEmpty()
+                {
+                        while (leaf_ != nullptr && slot_ == leaf_->count)
+                        {
+                                leaf_ = leaf_->next;
+                                slot_ = 0;
+                        }
+                }
+
+                const Leaf* leaf_;
+                size_t slot_;
+        };
+
+        BPlusTree()
+                : head_(new Leaf)
+                , root_(head_)
+        {}
+        BPlusTree(const BPlusTree&) = delete;
+        BPlusTree& operator=(const BPlusTree&) = delete;
+        ~BPlusTree() { destroy(root_, height_); }
+
+        size_t size()const { return size_; }
+        Cursor begin()const { return Cursor(head_, 0); }
+
+        Cursor lower_bound(int64_t key)const
+        {
+                const Leaf* leaf = findLeaf(key);
+                return Cursor(leaf, leafLowerBound(leaf, key));
+        }
+
+        const Value* find(int64_t key)const
+        {
+                const Leaf* leaf = findLeaf(key);
+                const auto slot = leafLowerBound(leaf, key);
+                return slot != leaf->count && leaf->keys[slot] == key ? &leaf->values[slot] : nullptr;
+        }
+
+        // returns false when the key was already there, its value is replaced
+        bool insert(int64_t key, const Value& value)
+        {
+                bool inserted = false;
+                if (const auto split = insertInto(root_, height_, key, value, inserted))
+                {
+                        auto* root = new Inner;
+                        root->keys[0] = split->key;
+                        root->children[0] = root_;
+                        root->children[1] = split->right;
+                        root->count = 1;
+                        root_ = root;
+                        ++height_;
+                }
+                size_ += inserted;
+                return inserted;
+        }
+
+        bool erase(int64_t key)
+        {
+                Leaf* leaf = const_cast<Leaf*>(findLeaf(key));
+                const auto slot = leafLowerBound(leaf, key);
+                if (slot == leaf->count || leaf->keys[slot] != key)
+                {
+                        return false;
+                }
+                std::move(leaf->keys.begin() + slot + 1, leaf->keys.begin() + leaf->count, leaf->keys.begin() + slot);
+                std::move(leaf->values.begin() + slot + 1, leaf->values.begin() + leaf->count, leaf->values.begin() + slot);
+                --leaf->count;
+                --size_;
+                return true;
+        }
+private:
+        static size_t childIndex(const Inner* inner, int64_t key)
+        {
+                size_t idx = 0;
+                for (size_t k = 0; k != InnerKeys; ++k)
+                {
+                        idx += inner->keys[k] <= key;
+                }
+                // max() is a valid key and also the padding, don't step past
+                // the last child
+                return std::min(idx, inner->count);
+        }
+        static size_t leafLowerBound(const Leaf* leaf, int64_t key)
+        {
+                return static_cast<size_t>(std::lower_bound(leaf->keys.begin(), leaf->keys.begin() + leaf->count, key) - leaf->keys.begin());
+        }
+
+        const Leaf* findLeaf(int64_t key)const
+        {
+                const void* node = root_;
+                for (size_t level = height_; level != 0; --level)
+                {
+                        const auto* inner = static_cast<const Inner*>(node);
+                        node = inner->children[childIndex(inner, key)];
+                }
+                return static_cast<const Leaf*>(node);
+        }
+
+        std::optional<Split> insertInto(void* node, size_t level, int64_t key, const Value& value, bool& inserted)
+        {
+                if (level == 0)
+                {
+                        return insertLeaf(static_cast<Leaf*>(node), key, value, inserted);
+                }
+                auto* inner = static_cast<Inner*>(node);
+                const auto idx = childIndex(inner, key);
+                const auto split = insertInto(inner->children[idx], level - 1, key, value, inserted);
+                if (!split)
+                {
+                        return std::nullopt;
+                }
+                if (inner->count != InnerKeys)
+                {
+                        std::move_backward(inner->keys.begin() + idx, inner->keys.begin() + inner->count, inner->keys.begin() + inner->count + 1);
+                        std::move_backward(inner->children.begin() + idx + 1, inner->children.begin() + inner->count + 1, inner->children.begin() + inner->count + 2);
+                        inner->keys[idx] = split->key;
+                        inner->children[idx + 1] = split->right;
+                        ++inner->count;
+                        return std::nullopt;
+                }
+                // full, lay the node out with the new entry then cut it in two,
+                // the middle key moves up
+                std::array<int64_t, InnerKeys + 1> keys;
+                std::array<void*, InnerKeys + 2> children;
+                std::copy(inner->keys.begin(), inner->keys.begin() + idx, keys.begin());
+                keys[idx] = split->key;
+                std::copy(inner->keys.begin() + idx, inner->keys.end(), keys.begin() + idx + 1);
+                std::copy(inner->children.begin(), inner->children.begin() + idx + 1, children.begin());
+                children[idx + 1] = split->right;
+                std::copy(inner->children.begin() + idx + 1, inner->children.end(), children.begin() + idx + 2);
+
+                constexpr size_t mid = (InnerKeys + 1) / 2;
+                auto* right = new Inner;
+                inner->keys.fill(Padding);
+                std::copy(keys.begin(), keys.begin() + mid, inner->keys.begin());
+                std::copy(children.begin(), children.begin() + mid + 1, inner->children.begin());
+                inner->count = mid;
+                std::copy(keys.begin() + mid + 1, keys.end(), right->keys.begin());
+                std::copy(children.begin() + mid + 1, children.end(), right->children.begin());
+                right->count = InnerKeys - mid;
+                return Split{ keys[mid], right };
+        }
+
+        std::optional<Split> insertLeaf(Leaf* leaf, int64_t key, const Value& value, bool& inserted)
+        {
+                auto slot = leafLowerBound(leaf, key);
+                if (slot != leaf->count && leaf->keys[slot] == key)
+                {
+                        leaf->values[slot] = value;
+                        return std::nullopt;
+                }
+                inserted = true;
+                std::optional<Split> split;
+                if (leaf->count == LeafKeys)
+                {
+                        constexpr size_t half = LeafKeys / 2;
+                        auto* right = new Leaf;
+                        std::copy(leaf->keys.begin() + half, leaf->keys.end(), right->keys.begin());
+                        std::copy(leaf->values.begin() + half, leaf->values.end(), right->values.begin());
+                        right->count = LeafKeys - half;
+                        right->next = leaf->next;
+                        leaf->count = half;
+                        leaf->next = right;
+                        split = Split{ right->keys[0], right };
+                        if (slot > half)
+                        {
+                                leaf = right;
+                                slot -= half;
+                        }
+                }
+                std::move_backward(leaf->keys.begin() + slot, leaf->keys.begin() + leaf->count, leaf->keys.begin() + leaf->count + 1);
+                std::move_backward(leaf->values.begin() + slot, leaf->values.begin() + leaf->count, leaf->values.begin() + leaf->count + 1);
+                leaf->keys[slot] = key;
+                leaf->values[slot] = value;
+                ++leaf->count;
+                return split;
+        }
+
+        static void destroy(void* node, size_t level)
+        {
+                if (level == 0)
+                {
+                        delete static_cast<Leaf*>(node);
+                        return;
+                }
+                auto* inner = static_cast<Inner*>(node);
+                for (size_t idx = 0; idx != inner->count + 1; ++idx)
+                {
+                        destroy(inner->children[idx], level - 1);
+                }
+                delete inner;
+        }
+
+        Leaf* head_;
+        void* root_;
+        size_t height_ = 0;
+        size_t size_ = 0;
+};
+
+// the shapes of key set the learned index is tried on. Dense is what
+// makeMapAndIndex produces, Gapped is runs of consecutive keys with the
+// odd large jump, like timestamps with quiet periods, and Clustered is
+// normally distributed keys around a handful of random centres
+enum class KeyDistribution
+{
+        Dense,
+        Gapped,
+        Clustered,
+};
+
+static const char* toString(KeyDistribution dist)
+{
+        switch (dist)
+        {
+        case KeyDistribution::Dense: return "dense";
+        case KeyDistribution::Gapped: return "gapped";
+        case KeyDistribution::Clustered: return "clustered";
+        }
+        throw std::domain_error("unknown key distribution");
+}
+
+constexpr size_t KeyClusters = 16;
+
+// sorted unique keys plus LayoutLookups keys sampled from them
+static std::tuple<std::vector<int64_t>, std::vector<int64_t> > makeDistributedKeysAndIndex(KeyDistribution dist, int64_t size)
+{
+        std::mt19937_64 g{ 42 };
+        std::vector<int64_t> keys;
+        keys.reserve(static_cast<size_t>(size));
+        switch (dist)
+        {
+        case KeyDistribution::Dense:
+                for (int64_t key = 0; key != size; ++key)
+                {
+                        keys.push_back(key);
+                }
+                break;
+        case KeyDistribution::Gapped:
+        {
+                std::bernoulli_distribution jump(1.0 / 64);
+                std::uniform_int_distribution<int64_t> gap(1 << 10, 1 << 20);
+                int64_t key = 0;
+                for (int64_t iter = 0; iter != size; ++iter)
+                {
+                        keys.push_back(key);
+                        key += jump(g) ? gap(g) : 1;
+                }
+                break;
+        }
+        case KeyDistribution::Clustered:
+        {
+                std::uniform_int_distribution<int64_t> centre(0, int64_t(1) << 40);
+                std::array<int64_t, KeyClusters> centres;
+                std::generate(centres.begin(), centres.end(), [&]() { return centre(g); });
+                std::normal_distribution<double> spread(0.0, static_cast<double>(size));
+                std::uniform_int_distribution<size_t> pick(0, KeyClusters - 1);
+                while (keys.size() != static_cast<size_t>(size))
+                {
+                        while (keys.size() != static_cast<size_t>(size))
+                        {
+                                keys.push_back(centres[pick(g)] + static_cast<int64_t>(std::llround(spread(g))));
+                        }
+                        std::sort(keys.begin(), keys.end());
+                        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                }
+                break;
+        }
+        }
+        std::vector<int64_t> index(LayoutLookups);
+        std::uniform_int_distribution<size_t> pos(0, keys.size() - 1);
+        std::generate(index.begin(), index.end(), [&]() { return keys[pos(g)]; });
+        return std::make_tuple(std::move(index), std::move(keys));
+}
+
+// piecewise linear model over a sorted key array. each segment predicts a
+// key's position to within Epsilon, so the last mile is a binary search of
+// 2 * Epsilon + 2 keys. segments are built greedily in one pass by keeping
+// the cone of slopes that fit every key so far. keys that aren't in the
+// array can land just outside the window, that's caught and searched for
+// on the right side
+class LearnedIndex
+{
+public:
+        explicit LearnedIndex(std::vector<int64_t> keys, size_t epsilon = 32)
+                : keys_(std::move(keys))
+                , epsilon_(epsilon)
+        {
+                const auto eps = static_cast<double>(epsilon_);
+                size_t first = 0;
+                while (first < keys_.size())
+                {
+                        double slopeLow = 0.0;
+                        double slopeHigh = std::numeric_limits<double>::infinity();
+                        size_t last = first + 1;
+                        for (; last < keys_.size(); ++last)
+                        {
+                                const auto dx = static_cast<double>(keys_[last] - keys_[first]);
+                                const auto dy = static_cast<double>(last - first);
+                                if (dy / dx < slopeLow || dy / dx > slopeHigh)
+                                {
+                                        break;
+                                }
+                                slopeLow = std::max(slopeLow, (dy - eps) / dx);
+                                slopeHigh = std::min(slopeHigh, (dy + eps) / dx);
+                        }
+                        const double slope = last == first + 1 ? 0.0 : (slopeLow + slopeHigh) / 2;
+                        firstKeys_.push_back(keys_[first]);
+                        segments_.push_back(Segment{ keys_[first], slope, first });
+                        first = last;
+                }
+        }
+
+        size_t size()const { return keys_.size(); }
+        size_t segments()const { return segments_.size(); }
+        size_t modelBytes()const { return segments_.size() * sizeof(Segment) + firstKeys_.size() * sizeof(int64_t); }
+
+        size_t lower_bound(int64_t key)const
+        {
+                const auto n = keys_.size();
+                const auto next = std::upper_bound(firstKeys_.begin(), firstKeys_.end(), key);
+                if (next == firstKeys_.begin())
+                {
+                        return 0;
+                }
+                const auto& segment = segments_[static_cast<size_t>(next - firstKeys_.begin()) - 1];
+                const auto guess = static_cast<double>(segment.first) + segment.slope * static_cast<double>(key - segment.firstKey);
+                const auto predicted = static_cast<size_t>(std::min(std::max(guess, 0.0), static_cast<double>(n - 1)));
+                const size_t lo = predicted > epsilon_ + 1 ? predicted - epsilon_ - 1 : 0;
+                const size_t hi = std::min(predicted + epsilon_ + 2, n);
+                auto pos = static_cast<size_t>(std::lower_bound(keys_.begin() + lo, keys_.begin() + hi, key) - keys_.begin());
+                if (pos == lo && lo != 0 && keys_[lo - 1] >= key)
+                {
+                        pos = static_cast<size_t>(std::lower_bound(keys_.begin(), keys_.begin() + lo, key) - keys_.begin());
+                }
+                else if (pos == hi && hi != n)
+                {
+                        pos = static_cast<size_t>(std::lower_bound(keys_.begin() + hi, keys_.end(), key) - keys_.begin());
+                }
+                return pos;
+        }
+private:
+        struct Segment
+        {
+                int64_t firstKey;
+                double slope;
+                size_t first;
+        };
+
+        std::vector<int64_t> keys_;
+        size_t epsilon_;
+        std::vector<int64_t> firstKeys_;
+        std::vector<Segment> segments_;
+};
+
+// halves the range with a conditional move instead of a branch, so the
+// search never mispredicts, it just waits on the loads
+inline size_t branchlessLowerBound(const int64_t* keys, size_t n, int64_t key)
+{
+        if (n == 0)
+        {
+                return 0;
+        }
+        const int64_t* base = keys;
+        while (n > 1)
+        {
+                const size_t half = n / 2;
+                base = base[half - 1] < key ? base + half : base;
+                n -= half;
+        }
+        return static_cast<size_t>(base - keys) + (*base < key);
+}
+
+// the number of keys in [first, first + Width) less than key
+template<size_t Width>
+inline size_t countLess(const int64_t* first, int64_t key)
+{
+#ifdef __AVX2__
+        static_assert(Width % 4 == 0, "AVX2 compares 4 keys at a time");
+        const __m256i needle = _mm256_set1_epi64x(key);
+        size_t count = 0;
+        for (size_t idx = 0; idx != Width; idx += 4)
+        {
+                const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + idx));
+                const __m256i less = _mm256_cmpgt_epi64(needle, block);
+                count += std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(less))));
+        }
+        return count;
+#else
+        size_t count = 0;
+        for (size_t idx = 0; idx != Width; ++idx)
+        {
+                count += first[idx] < key;
+        }
+        return count;
+#endif
+}
+
+// labels the simd results, without AVX2 (msvc without /arch:AVX2) countLess
+// is the scalar loop
+#ifdef __AVX2__
+constexpr const char* CountLessMode = "avx2";
+#else
+constexpr const char* CountLessMode = "scalar";
+#endif
+
+// branchless halving until Width keys are left, then one wide compare
+// counts the keys below the needle. the window is slid back from the end of
+// the array when it would overrun, everything in front of it is less than
+// the key anyway
+template<size_t Width>
+inline size_t simdLowerBound(const int64_t* keys, size_t n, int64_t key)
+{
+        if (n < Width)
+        {
+                return branchlessLowerBound(keys, n, key);
+        }
+        const int64_t* base = keys;
+        size_t len = n;
+        while (len > Width)
+        {
+                const size_t half = len / 2;
+                base = base[half - 1] < key ? base + half : base;
+                len -= half;
+        }
+        const int64_t* window = std::min(base, keys + n - Width);
+        return static_cast<size_t>(window - keys) + countLess<Width>(window, key);
+}
+
+// G searches over the same array advance in lockstep, they all take the
+// same number of halving steps, so their loads are independent and overlap.
+// the probe of the next step was prefetched on the previous one, so each
+// step prefetches the two places the step after next can probe
+template<size_t G>
+inline void lowerBoundGroup(const int64_t* keys, size_t n, const int64_t* queries, size_t* out)
+{
+        const int64_t* base[G];
+        for (size_t g = 0; g != G; ++g)
+        {
+                base[g] = keys;
+        }
+        size_t len = n;
+        while (len > 1)
+        {
+                const size_t half = len / 2;
+                for (size_t g = 0; g != G; ++g)
+                {
+                        base[g] = base[g][half - 1] < queries[g] ? base[g] + half : base[g];
+                }
+                len -= half;
+                // the next step probes base[next - 1] and moves to base or
+                // base + next, leaving len - next keys
+                const size_t next = len / 2;
+                const size_t after = (len - next) / 2;
+                if (after != 0)
+                {
+                        for (size_t g = 0; g != G; ++g)
+                        {
+                                prefetchKey(base[g], after - 1);
+                                prefetchKey(base[g], next + after - 1);
+                        }
+                }
+        }
+        for (size_t g = 0; g != G; ++g)
+        {
+                out[g] = static_cast<size_t>(base[g] - keys) + (n != 0 && *base[g] < queries[g]);
+        }
+}
+
+// out[i] is the lower bound of queries[i], resolved G at a time
+template<size_t G>
+void lowerBoundBatch(const int64_t* keys, size_t n, const int64_t* queries, size_t count, size_t* out)
+{
+        size_t idx = 0;
+        for (; idx + G <= count; idx += G)
+        {
+                lowerBoundGroup<G>(keys, n, queries + idx, out + idx);
+        }
+        for (; idx != count; ++idx)
+        {
+                out[idx] = branchlessLowerBound(keys, n, queries[idx]);
+        }
+}
+
+// std::map doesn't expose its nodes, so the descents can't be interleaved.
+// instead each group of G keys is sorted and resolved in key order, so the
+// top of the tree stays hot, and a key close behind the previous answer is
+// found by stepping forward rather than searching again
+constexpr size_t MapBatchMaxSteps = 4;
+
+template<size_t G, class Map>
+void lowerBoundBatch(const Map& m, const int64_t* queries, size_t count, typename Map::const_iterator* out)
+{
+        std::array<size_t, G> order;
+        for (size_t first = 0; first < count; first += G)
+        {
+                const size_t group = std::min(G, count - first);
+                // insertion sort, groups are at most 32 keys
+                for (size_t idx = 0; idx != group; ++idx)
+                {
+                        size_t pos = idx;
+                        for (; pos != 0 && queries[order[pos - 1]] > queries[first + idx]; --pos)
+                        {
+                                order[pos] = order[pos - 1];
+                        }
+                        order[pos] = first + idx;
+                }
+                auto prev = m.lower_bound(queries[order[0]]);
+                out[order[0]] = prev;
+                for (size_t idx = 1; idx != group; ++idx)
+                {
+                        const auto key = queries[order[idx]];
+                        size_t steps = 0;
+                        while (prev != m.end() && prev->first < key && steps != MapBatchMaxSteps)
+                        {
+                                ++prev;
+                                ++steps;
+                        }
+                        if (prev != m.end() && prev->first < key)
+                        {
+                                prev = m.lower_bound(key);
+                        }
+                        out[order[idx]] = prev;
+                }
+        }
+}
+
+// splitmix64 finaliser, the keys are often dense so they need mixing
+inline uint64_t mixKey(int64_t key)
+{
+        auto x = static_cast<uint64_t>(key);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+}
+
+// open addressing with a control byte per slot, swiss table style. a probe
+// loads a group of 16 control bytes and compares them all against the top
+// 7 bits of the hash in one SSE2 instruction, so only slots whose tag
+// matches have their key looked at. erased slots become tombstones, which
+// keep probe chains intact until the next rehash
+template<class Value>
+class FlatHashMap
+{
+public:
+        static constexpr size_t Group = 16;
+
+        explicit FlatHashMap(double maxLoadFactor = 0.875)
+                : maxLoadFactor_(maxLoadFactor)
+        {
+                if (!(maxLoadFactor > 0.0 && maxLoadFactor < 1.0))
+                {
+                        throw std::domain_error("max load factor must be in (0, 1)");
+                }
+        }
+
+        size_t size()const { return size_; }
+        size_t capacity()const { return ctrl_.size(); }
+        size_t memoryBytes()const
+        {
+                return ctrl_.capacity() * sizeof(int8_t) + keys_.capacity() * sizeof(int64_t) + values_.capacity() * sizeof(Value);
+        }
+
+        const Value* find(int64_t key)const
+        {
+                const auto slot = findSlot(key);
+                return slot == npos ? nullptr : &values_[slot];
+        }
+
+        bool insert(int64_t key, const Value& value)
+        {
+                if (findSlot(key) != npos)
+                {
+                        return false;
+                }
+                if (static_cast<double>(size_ + tombstones_ + 1) > maxLoadFactor_ * static_cast<double>(capacity()))
+                {
+                        grow();
+                }
+                insertUnique(key, value);
+                return true;
+        }
+
+        bool erase(int64_t key)
+        {
+                const auto slot = findSlot(key);
+                if (slot == npos)
+                {
+                        return false;
+                }
+                ctrl_[slot] = Deleted;
+                --size_;
+                ++tombstones_;
+                return true;
+        }
+private:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+        static constexpr int8_t Empty = -128;
+        static constexpr int8_t Deleted = -2;
+
+        static uint64_t hashOf(int64_t key) { return mixKey(key); }
+        static int8_t tagOf(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+        unsigned matchGroup(size_t group, int8_t byte)const
+        {
+                const auto ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl_.data() + group * Group));
+                return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte))));
+        }
+
+        // triangular probing over a power of two number of groups visits
+        // every group, and the load factor guarantees an empty slot
+        size_t findSlot(int64_t key)const
+        {
+                if (size_ == 0)
+                {
+                        return npos;
+                }
+                const auto hash = hashOf(key);
+                const auto tag = tagOf(hash);
+                const size_t groupMask = capacity() / Group - 1;
+                size_t group = (hash >> 7) & groupMask;
+                for (size_t step = 1;; ++step)
+                {
+                        for (auto match = matchGroup(group, tag); match != 0; match &= match - 1)
+                        {
+                                const size_t slot = group * Group + std::countr_zero(match);
+                                if (keys_[slot] == key)
+                                {
+                                        return slot;
+                                }
+                        }
+                        if (matchGroup(group, Empty) != 0)
+                        {
+                                return npos;
+                        }
+                        group = (group + step) & groupMask;
+                }
+        }
+
+        void insertUnique(int64_t key, const Value& value)
+        {
+                const auto hash = hashOf(key);
+                const size_t groupMask = capacity() / Group - 1;
+                size_t group = (hash >> 7) & groupMask;
+                for (size_t step = 1;; ++step)
+                {
+                        const auto free = matchGroup(group, Empty) | matchGroup(group, Deleted);
+                        if (free != 0)
+                        {
+                                const size_t slot = group * Group + std::countr_zero(free);
+                                if (ctrl_[slot] == Deleted)
+                                {
+                                        --tombstones_;
+                                }
+                                ctrl_[slot] = tagOf(hash);
+                                keys_[slot] = key;
+                                values_[slot] = value;
+                                ++size_;
+                                return;
+                        }
+                        group = (group + step) & groupMask;
+                }
+        }
+
+        // doubles when live entries are the problem, otherwise rehashes in
+        // place to clear the tombstones
+        void grow()
+        {
+                size_t newCapacity = std::max(capacity(), Group);
+                if (static_cast<double>(size_ + 1) > maxLoadFactor_ * static_cast<double>(newCapacity) / 2)
+                {
+                        newCapacity *= 2;
+                }
+                while (static_cast<double>(size_ + 1) > maxLoadFactor_ * static_cast<double>(newCapacity))
+                {
+                        newCapacity *= 2;
+                }
+                auto ctrl = std::move(ctrl_);
+                auto keys = std::move(keys_);
+                auto values = std::move(values_);
+                ctrl_.assign(newCapacity, Empty);
+                keys_.assign(newCapacity, 0);
+                values_.assign(newCapacity, Value{});
+                size_ = 0;
+                tombstones_ = 0;
+                for (size_t slot = 0; slot != ctrl.size(); ++slot)
+                {
+                        if (ctrl[slot] >= 0)
+                        {
+                                insertUnique(keys[slot], values[slot]);
+                        }
+                }
+        }
+
+        double maxLoadFactor_;
+        size_t size_ = 0;
+        size_t tombstones_ = 0;
+        std::vector<int8_t, AlignedAllocator<int8_t, Group> > ctrl_;
+        std::vector<int64_t> keys_;
+        std::vector<Value> values_;
+};
+
+// counts what a standard container allocates, for the memory per entry
+template<class T>
+struct CountingAllocator
+{
+        using value_type = T;
+
+        explicit CountingAllocator(size_t* bytes) noexcept : bytes(bytes) {}
+        template<class U>
+        CountingAllocator(const CountingAllocator<U>& other) noexcept : bytes(other.bytes) {}
+
+        T* allocate(size_t n)
+        {
+                *bytes += n * sizeof(T);
+                return std::allocator<T>{}.allocate(n);
+        }
+        void deallocate(T* ptr, size_t n) noexcept
+        {
+                *bytes -= n * sizeof(T);
+                std::allocator<T>{}.deallocate(ptr, n);
+        }
+        template<class U>
+        bool operator==(const CountingAllocator<U>& other)const noexcept { return bytes == other.bytes; }
+        template<class U>
+        bool operator!=(const CountingAllocator<U>& other)const noexcept { return bytes != other.bytes; }
+
+        size_t* bytes;
+};
+
+// the point lookup benchmarks are written once against these, each one has
+// find, insert, erase and memoryBytes
+using PointValue = std::array<std::byte, 8>;
+
+struct SortedVectorPoints
+{
+        using Pair = std::pair<int64_t, PointValue>;
+
+        SortedVectorPoints() : items(CountingAllocator<Pair>(&bytes)) {}
+
+        const PointValue* find(int64_t key)const
+        {
+                const auto iter = std::lower_bound(items.begin(), items.end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                return iter != items.end() && iter->first == key ? &iter->second : nullptr;
+        }
+        void insert(int64_t key, const PointValue& value)
+        {
+                const auto iter = std::lower_bound(items.begin(), items.end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                if (iter == items.end() || iter->first != key)
+                {
+                        items.emplace(iter, key, value);
+                }
+        }
+        void erase(int64_t key)
+        {
+                const auto iter = std::lower_bound(items.begin(), items.end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                if (iter != items.end() && iter->first == key)
+                {
+                        items.erase(iter);
+                }
+        }
+        size_t memoryBytes()const { return bytes; }
+
+        size_t bytes = 0;
+        std::vector<Pair, CountingAllocator<Pair> > items;
+};
+
+struct StdMapPoints
+{
+        using Pair = std::pair<const int64_t, PointValue>;
+
+        StdMapPoints() : items(CountingAllocator<Pair>(&bytes)) {}
+
+        const PointValue* find(int64_t key)const
+        {
+                const auto iter = items.find(key);
+                return iter != items.end() ? &iter->second : nullptr;
+        }
+        void insert(int64_t key, const PointValue& value) { items.emplace(key, value); }
+        void erase(int64_t key) { items.erase(key); }
+        size_t memoryBytes()const { return bytes; }
+
+        size_t bytes = 0;
+        std::map<int64_t, PointValue, std::less<int64_t>, CountingAllocator<Pair> > items;
+};
+
+struct StdUnorderedMapPoints
+{
+        using Pair = std::pair<const int64_t, PointValue>;
+
+        StdUnorderedMapPoints() : items(0, std::hash<int64_t>{}, std::equal_to<int64_t>{}, CountingAllocator<Pair>(&bytes)) {}
+
+        const PointValue* find(int64_t key)const
+        {
+                const auto iter = items.find(key);
+                return iter != items.end() ? &iter->second : nullptr;
+        }
+        void insert(int64_t key, const PointValue& value) { items.emplace(key, value); }
+        void erase(int64_t key) { items.erase(key); }
+        size_t memoryBytes()const { return bytes; }
+
+        size_t bytes = 0;
+        std::unordered_map<int64_t, PointValue, std::hash<int64_t>, std::equal_to<int64_t>, CountingAllocator<Pair> > items;
+};
+
+template<int MaxLoadPercent>
+struct FlatHashPoints
+{
+        const PointValue* find(int64_t key)const { return items.find(key); }
+        void insert(int64_t key, const PointValue& value) { items.insert(key, value); }
+        void erase(int64_t key) { items.erase(key); }
+        size_t memoryBytes()const { return items.memoryBytes(); }
+
+        FlatHashMap<PointValue> items{ MaxLoadPercent / 100.0 };
+};
+
+// LayoutLookups keys drawn from 0..size-1 with the i'th most popular key
+// chosen with probability proportional to 1 / i^exponent. exponent 0 is
+// uniform, around 1 is typical of production traffic. popularity is
+// assigned through a random permutation so the hot keys are spread out
+static std::vector<int64_t> makeZipfIndex(int64_t size, double exponent)
+{
+        std::vector<double> cdf(static_cast<size_t>(size));
+        double total = 0.0;
+        for (size_t rank = 0; rank != cdf.size(); ++rank)
+        {
+                total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+                cdf[rank] = total;
+        }
+        std::vector<int64_t> keyOfRank(cdf.size());
+        std::iota(keyOfRank.begin(), keyOfRank.end(), 0);
+        std::mt19937_64 g{ 42 };
+        std::shuffle(keyOfRank.begin(), keyOfRank.end(), g);
+
+        std::uniform_real_distribution<double> uniform(0.0, total);
+        std::vector<int64_t> index(LayoutLookups);
+        for (auto& key : index)
+        {
+                const auto rank = std::min(static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), uniform(g)) - cdf.begin()), cdf.size() - 1);
+                key = keyOfRank[rank];
+        }
+        return index;
+}
+
+// direct mapped cache of found entries that can sit in front of any of the
+// structures, find takes the lookup to run on a miss. a write to the
+// structure has to invalidate its key. the key min() marks an empty slot
+template<class Value, size_t Slots>
+class HotKeyCache
+{
+public:
+        static_assert(std::has_single_bit(Slots), "slots must be a power of two");
+
+        template<class Lookup>
+        const Value* find(int64_t key, Lookup&& lookup)
+        {
+                auto& entry = entries_[slotOf(key)];
+                if (entry.key == key)
+                {
+                        ++hits_;
+                        return &entry.value;
+                }
+                ++misses_;
+                const Value* found = lookup(key);
+                if (found != nullptr)
+                {
+                        entry.key = key;
+                        entry.value = *found;
+                }
+                return found;
+        }
+        void invalidate(int64_t key)
+        {
+                auto& entry = entries_[slotOf(key)];
+                if (entry.key == key)
+                {
+                        entry.key = Empty;
+                }
+        }
+
+        size_t bytes()const { return sizeof(entries_); }
+        double hitRate()const
+        {
+                return hits_ + misses_ == 0 ? 0.0 : static_cast<double>(hits_) / static_cast<double>(hits_ + misses_);
+        }
+private:
+        static constexpr int64_t Empty = std::numeric_limits<int64_t>::min();
+
+        static size_t slotOf(int64_t key)
+        {
+                return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> (64 - std::countr_zero(Slots)));
+        }
+
+        struct Entry
+        {
+                int64_t key = Empty;
+                Value value{};
+        };
+
+        std::array<Entry, Slots> entries_;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+};
+
+// bloom filter where all of a key's bits land in one cache line sized
+// block, so a query costs one cache miss however many bits it checks. the
+// bit positions come from double hashing the two halves of one mixed hash
+class BlockedBloomFilter
+{
+public:
+        BlockedBloomFilter(size_t keys, size_t bitsPerKey = 10)
+                : blocks_(std::max<size_t>(1, (keys * bitsPerKey + BlockBits - 1) / BlockBits))
+                , probes_(std::clamp<size_t>(static_cast<size_t>(std::lround(static_cast<double>(bitsPerKey) * 0.693)), 1, 16))
+        {}
+
+        void insert(int64_t key)
+        {
+                const auto hash = mixKey(key);
+                auto& block = blocks_[blockOf(hash)];
+                forEachBit(hash, [&](size_t bit) { block.words[bit / 64] |= uint64_t(1) << (bit % 64); });
+        }
+
+        bool mayContain(int64_t key)const
+        {
+                const auto hash = mixKey(key);
+                const auto& block = blocks_[blockOf(hash)];
+                bool found = true;
+                forEachBit(hash, [&](size_t bit) { found &= ((block.words[bit / 64] >> (bit % 64)) & 1) != 0; });
+                return found;
+        }
+
+        size_t bytes()const { return blocks_.size() * sizeof(Block); }
+private:
+        static constexpr size_t BlockBits = CacheLineSize * 8;
+
+        struct alignas(CacheLineSize) Block
+        {
+                std::array<uint64_t, CacheLineSize / sizeof(uint64_t)> words{};
+        };
+
+        size_t blockOf(uint64_t hash)const
+        {
+                return static_cast<size_t>(((hash >> 32) * blocks_.size()) >> 32);
+        }
+
+        template<class F>
+        void forEachBit(uint64_t hash, F&& f)const
+        {
+                const auto a = static_cast<uint32_t>(hash);
+                const auto b = static_cast<uint32_t>(hash >> 32) | 1;
+                for (size_t probe = 0; probe != probes_; ++probe)
+                {
+                        f(static_cast<size_t>(a + probe * b) % BlockBits);
+                }
+        }
+
+        std::vector<Block> blocks_;
+        size_t probes_;
+};
+
+// the structure holds the even keys 0, 2, .. 2(size-1), a miss is an odd
+// key inside that range so it still costs a full search
+static std::vector<int64_t> makeMissIndex(int64_t size, double missRatio)
+{
+        std::mt19937_64 g{ 42 };
+        std::uniform_int_distribution<int64_t> pick(0, size - 1);
+        std::bernoulli_distribution miss(missRatio);
+        std::vector<int64_t> index(LayoutLookups);
+        std::generate(index.begin(), index.end(), [&]() { return 2 * pick(g) + (miss(g) ? 1 : 0); });
+        return index;
+}
+
+// epoch based reclamation for one writer and up to MaxReaders readers, each
+// reader owns a slot. a reader publishes the epoch it started in for as long
+// as it holds a snapshot, the writer frees a retired snapshot once no slot
+// shows an epoch from before it was swapped out
+class EpochDomain
+{
+public:
+        static constexpr size_t MaxReaders = 64;
+        static constexpr uint64_t Idle = std::numeric_limits<uint64_t>::max();
+
+        void enter(size_t slot) { slots_[slot].epoch.store(epoch_.load()); }
+        void exit(size_t slot) { slots_[slot].epoch.store(Idle, std::memory_order_release); }
+
+        // called after the old pointer has been swapped out, returns the
+        // epoch it has to be retired with
+        uint64_t advance() { return epoch_.fetch_add(1) + 1; }
+
+        uint64_t oldestActive()const
+        {
+                uint64_t oldest = Idle;
+                for (const auto& slot : slots_)
+                {
+                        oldest = std::min(oldest, slot.epoch.load());
+                }
+                return oldest;
+        }
+private:
+        struct alignas(64) Slot
+        {
+                std::atomic<uint64_t> epoch{ Idle };
+        };
+
+        std::atomic<uint64_t> epoch_{ 1 };
+        std::array<Slot, MaxReaders> slots_;
+};
+
+// read mostly sorted index. readers search an immutable snapshot without
+// taking a lock, the writer copies the snapshot, applies the change and
+// swaps the pointer in, rcu style. old snapshots are freed through the
+// EpochDomain. only one writer at a time
+template<class Value>
+class RcuSortedIndex
+{
+public:
+        using Snapshot = std::vector<std::pair<int64_t, Value> >;
+
+        explicit RcuSortedIndex(Snapshot items)
+                : current_(new Snapshot(std::move(items)))
+        {}
+        RcuSortedIndex(const RcuSortedIndex&) = delete;
+        RcuSortedIndex& operator=(const RcuSortedIndex&) = delete;
+        ~RcuSortedIndex()
+        {
+                delete current_.load();
+                for (auto& retired : retired_)
+                {
+                        delete retired.second;
+                }
+        }
+
+        bool find(size_t slot, int64_t key, Value& out)const
+        {
+                if (slot >= EpochDomain::MaxReaders)
+                {
+                        throw std::domain_error("too many reader threads");
+                }
+                domain_.enter(slot);
+                const Snapshot& items = *current_.load();
+                const auto iter = std::lower_bound(items.begin(), items.end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                const bool found = iter != items.end() && iter->first == key;
+                if (found)
+                {
+                        out = iter->second;
+                }
+                domain_.exit(slot);
+                return found;
+        }
+
+        void insert(int64_t key, const Value& value)
+        {
+                auto next = std::make_unique<Snapshot>(*current_.load(std::memory_order_relaxed));
+                const auto iter = std::lower_bound(next->begin(), next->end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                if (iter != next->end() && iter->first == key)
+                {
+                        iter->second = value;
+                }
+                else
+                {
+                        next->emplace(iter, key, value);
+                }
+                publish(next.release());
+        }
+
+        void erase(int64_t key)
+        {
+                auto next = std::make_unique<Snapshot>(*current_.load(std::memory_order_relaxed));
+                const auto iter = std::lower_bound(next->begin(), next->end(), key, [](const auto& p, int64_t k) { return p.first < k; });
+                if (iter != next->end() && iter->first == key)
+                {
+                        next->erase(iter);
+                }
+                publish(next.release());
+        }
+
+        size_t pendingReclaim()const { return retired_.size(); }
+private:
+        void publish(Snapshot* next)
+        {
+                Snapshot* prev = current_.exchange(next);
+                retired_.emplace_back(domain_.advance(), prev);
+                const auto oldest = domain_.oldestActive();
+                retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&](auto& retired) {
+                        if (retired.first > oldest)
+                        {
+                                return false;
+                        }
+                        delete retired.second;
+                        return true; }), retired_.end());
+        }
+
+        std::atomic<Snapshot*> current_;
+        mutable EpochDomain domain_;
+        std::vector<std::pair<uint64_t, Snapshot*> > retired_;
+};
+
+// the comparison point, a std::map behind a reader writer lock
+template<class Value>
+class SharedMutexMap
+{
+public:
+        explicit SharedMutexMap(std::map<int64_t, Value> items)
+                : items_(std::move(items))
+        {}
+
+        bool find(size_t, int64_t key, Value& out)const
+        {
+                std::shared_lock<std::shared_mutex> lock(mutex_);
+                const auto iter = items_.find(key);
+                if (iter == items_.end())
+                {
+                        return false;
+                }
+                out = iter->second;
+                return true;
+        }
+        void insert(int64_t key, const Value& value)
+        {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                items_.insert_or_assign(key, value);
+        }
+        void erase(int64_t key)
+        {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                items_.erase(key);
+        }
+private:
+        mutable std::shared_mutex mutex_;
+        std::map<int64_t, Value> items_;
+};
+
+// keeps one key past the end coming and going every WriterInterval while
+// the readers run, and times each update including any wait for the lock
+constexpr auto WriterInterval = std::chrono::milliseconds(10);
+constexpr size_t ReaderLookupsPerIteration = 256;
+
+template<class Index>
+class BackgroundWriter
+{
+public:
+        BackgroundWriter(Index& index, int64_t size)
+                : index_(index)
+                , size_(size)
+                , thread_([this]() { run(); })
+        {}
+        ~BackgroundWriter() { stop(); }
+
+        void stop()
+        {
+                if (thread_.joinable())
+                {
+                        stop_.store(true);
+                        thread_.join();
+                }
+        }
+        const std::vector<double>& latencies()const { return latencies_; }
+private:
+        void run()
+        {
+                const std::array<std::byte, 8> value{};
+                for (size_t write = 0; !stop_.load(); ++write)
+                {
+                        const auto start = std::chrono::steady_clock::now();
+                        if (write % 2 == 0)
+                        {
+                                index_.insert(size_, value);
+                        }
+                        else
+                        {
+                                index_.erase(size_);
+                        }
+                        latencies_.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+                        std::this_thread::sleep_for(WriterInterval);
+                }
+        }
+
+        Index& index_;
+        int64_t size_;
+        std::atomic<bool> stop_{ false };
+        std::vector<double> latencies_;
+        std::thread thread_;
+};
+
+// production sized fixtures, 1M to 64M keys. only for the benchmarks whose
+// cost per lookup stays logarithmic, std::lower_bound over map iterators is
+// linear and would never finish. a map node is around 64 bytes, so 64M keys
+// is already 4GB
+static void LargeSizes(benchmark::internal::Benchmark* b)
+{
+        for (int64_t size : { int64_t(1) << 20, int64_t(1) << 23, int64_t(1) << 26 })
+        {
+                b->Arg(size);
+        }
+        b->Unit(benchmark::kMillisecond);
+}
+
+// a flat array is 16 bytes a key, so it goes on to 1B keys
+static void LargeFlatSizes(benchmark::internal::Benchmark* b)
+{
+        LargeSizes(b);
+        b->Arg(int64_t(1) << 30);
+}
+
+static void StdVectorStdLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        const auto index = makeLookupIndex(size);
+        const auto V = makeSortedVector<8>(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(std::lower_bound(V.begin(), V.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(StdVectorStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdVectorStdLowerBound)->Apply(LargeFlatSizes);
+
+static void StdMapMemberLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto M = makeStdMap<8>(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(M.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(StdMapMemberLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapMemberLowerBound)->Apply(LargeSizes);
+
+static void PmrMapMemberLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto pmrM = makePmrMap<8>(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(pmrM.lower_bound(i));
+                }
+        }
+}
+BENCHMARK(PmrMapMemberLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PmrMapMemberLowerBound)->Apply(LargeSizes);
+
+static void StdMapStdLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(std::lower_bound(M.begin(), M.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                }
+        }
+}
+BENCHMARK(StdMapStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+static void PmrMapStdLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(std::lower_bound(pmrM.begin(), pmrM.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                }
+        }
+}
+BENCHMARK(PmrMapStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+
+
+
+static void StdMapRead(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto M = makeStdMap<8>(size);
+
+        for (auto _ : state) {
+                for (const auto& p : M)
+                {
+                        benchmark::DoNotOptimize(p.first);
+                        benchmark::DoNotOptimize(p.second);
+                }
+        }
+}
+BENCHMARK(StdMapRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapRead)->Apply(LargeSizes);
+
+static void PmrMapRead(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto pmrM = makePmrMap<8>(size);
+
+        for (auto _ : state) {
+                for (const auto& p : pmrM)
+                {
+                        benchmark::DoNotOptimize(p.first);
+                        benchmark::DoNotOptimize(p.second);
+                }
+        }
+}
+BENCHMARK(PmrMapRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PmrMapRead)->Apply(LargeSizes);
+
+static void StdMapReadFresh(benchmark::State& state) {
+        const auto size = state.range(0);
+
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                const auto M = makeStdMap<8>(size);
+                state.ResumeTiming();
+                for (const auto& p : M)
+                {
+                        benchmark::DoNotOptimize(p.first);
+                        benchmark::DoNotOptimize(p.second);
+                }
+        }
+}
+BENCHMARK(StdMapReadFresh)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapReadFresh)->Apply(LargeSizes);
+
+static void PmrMapReadFresh(benchmark::State& state) {
+        const auto size = state.range(0);
+
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                const auto pmrM = makePmrMap<8>(size);
+                state.ResumeTiming();
+                for (const auto& p : pmrM)
+                {
+                        benchmark::DoNotOptimize(p.first);
+                        benchmark::DoNotOptimize(p.second);
+                }
+        }
+}
+BENCHMARK(PmrMapReadFresh)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PmrMapReadFresh)->Apply(LargeSizes);
+
+static void FlatMapLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto F = makeFlatMap<std::array<std::byte, 8> >(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(F.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(FlatMapLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(FlatMapLowerBound)->Apply(LargeFlatSizes);
+
+static void StdVectorRead(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto V = makeSortedVector<8>(size);
+
+        for (auto _ : state) {
+                for (const auto& p : V)
+                {
+                        benchmark::DoNotOptimize(p.first);
+                        benchmark::DoNotOptimize(p.second);
+                }
+        }
+}
+BENCHMARK(StdVectorRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdVectorRead)->Apply(LargeFlatSizes);
+
+static void FlatMapRead(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto F = makeFlatMap<std::array<std::byte, 8> >(size);
+
+        for (auto _ : state) {
+                for (size_t idx = 0; idx != F.size(); ++idx)
+                {
+                        benchmark::DoNotOptimize(F.keys()[idx]);
+                        benchmark::DoNotOptimize(F.values()[idx]);
+                }
+        }
+}
+BENCHMARK(FlatMapRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(FlatMapRead)->Apply(LargeFlatSizes);
+
+// the containers are copied fresh, untimed, every iteration
+static void StdVectorMixedInsertLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const auto newKeys = makeNewKeys(size);
+        const std::array<std::byte, 8> value{};
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto W = V;
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < newKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, newKeys.size());
+                        for (size_t idx = first; idx != last; ++idx)
+                        {
+                                const auto pos = std::lower_bound(W.begin(), W.end(), newKeys[idx], [](const auto& p, int64_t key) { return p.first < key; });
+                                W.emplace(pos, newKeys[idx], value);
+                        }
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(std::lower_bound(W.begin(), W.end(), index[lookup % index.size()], [](const auto& p, int64_t key) { return p.first < key; }));
+                        }
+                }
+        }
+}
+BENCHMARK(StdVectorMixedInsertLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+static void StdMapMixedInsertLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const auto newKeys = makeNewKeys(size);
+        const std::array<std::byte, 8> value{};
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto W = M;
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < newKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, newKeys.size());
+                        for (size_t idx = first; idx != last; ++idx)
+                        {
+                                W.emplace(newKeys[idx], value);
+                        }
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(W.lower_bound(index[lookup % index.size()]));
+                        }
+                }
+                state.PauseTiming();
+                W.clear();
+                state.ResumeTiming();
+        }
+}
+BENCHMARK(StdMapMixedInsertLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+static void PmrMapMixedInsertLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const auto newKeys = makeNewKeys(size);
+        const std::array<std::byte, 8> value{};
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                std::pmr::monotonic_buffer_resource resource;
+                std::pmr::map<int64_t, std::array<std::byte, 8>> W(pmrM.begin(), pmrM.end(), &resource);
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < newKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, newKeys.size());
+                        for (size_t idx = first; idx != last; ++idx)
+                        {
+                                W.emplace(newKeys[idx], value);
+                        }
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(W.lower_bound(index[lookup % index.size()]));
+                        }
+                }
+                state.PauseTiming();
+                W.clear();
+                resource.release();
+                state.ResumeTiming();
+        }
+}
+BENCHMARK(PmrMapMixedInsertLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+static void FlatMapMixedInsertLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto newKeys = makeNewKeys(size);
+        const auto F = makeFlatMap<std::array<std::byte, 8> >(size);
+        const std::array<std::byte, 8> value{};
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto W = F;
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < newKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, newKeys.size());
+                        std::vector<std::pair<int64_t, std::array<std::byte, 8> > > batch;
+                        for (size_t idx = first; idx != last; ++idx)
+                        {
+                                batch.emplace_back(newKeys[idx], value);
+                        }
+                        W.insert_batch(std::move(batch));
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(W.lower_bound(index[lookup % index.size()]));
+                        }
+                }
+        }
+}
+BENCHMARK(FlatMapMixedInsertLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(FlatMapMixedInsertLookup)->Apply(LargeSizes);
+
+// as the insert mix, but removing existing keys
+static void StdMapMixedEraseLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto eraseKeys = makeEraseKeys(size);
+        const auto M = makeStdMap<8>(size);
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto W = M;
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < eraseKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, eraseKeys.size());
+                        for (size_t idx = first; idx != last; ++idx)
+                        {
+                                W.erase(eraseKeys[idx]);
+                        }
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(W.lower_bound(index[lookup % index.size()]));
+                        }
+                }
+                state.PauseTiming();
+                W.clear();
+                state.ResumeTiming();
+        }
+}
+BENCHMARK(StdMapMixedEraseLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+
+static void FlatMapMixedEraseLookup(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        const auto eraseKeys = makeEraseKeys(size);
+        const auto F = makeFlatMap<std::array<std::byte, 8> >(size);
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto W = F;
+                state.ResumeTiming();
+                size_t lookup = 0;
+                for (size_t first = 0; first < eraseKeys.size(); first += MixedInsertBatch)
+                {
+                        const auto last = std::min(first + MixedInsertBatch, eraseKeys.size());
+                        W.erase_batch(std::vector<int64_t>(eraseKeys.begin() + first, eraseKeys.begin() + last));
+                        for (size_t n = 0; n != MixedLookupsPerBatch; ++n, ++lookup)
+                        {
+                                benchmark::DoNotOptimize(W.lower_bound(index[lookup % index.size()]));
+                        }
+                }
+        }
+}
+BENCHMARK(FlatMapMixedEraseLookup)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(FlatMapMixedEraseLookup)->Apply(LargeSizes);
+
+static void SortedKeysStdLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, keys] = makeSortedKeysAndIndex(size);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(std::lower_bound(keys.begin(), keys.end(), i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(SortedKeysStdLowerBound)->RangeMultiplier(8)->Range(2 << 5, 100'000'000);
+
+static void EytzingerLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, keys] = makeSortedKeysAndIndex(size);
+        const EytzingerIndex E(keys);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(E.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(EytzingerLowerBound)->RangeMultiplier(8)->Range(2 << 5, 100'000'000);
+
+static void STreeLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, keys] = makeSortedKeysAndIndex(size);
+        const STreeIndex S(keys);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(S.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(STreeLowerBound)->RangeMultiplier(8)->Range(2 << 5, 100'000'000);
 
-        std::map<int64_t, std::array<std::byte, ValueSize>> M;
-        std::pmr::map<int64_t, std::array<std::byte, ValueSize>> pmrM(&pool);
-        std::vector < std::pair<int64_t, std::array<std::byte, ValueSize> > > V;
-        std::vector<int64_t> index;
+static void BranchlessLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        std::vector<int64_t> keys(static_cast<size_t>(size));
+        std::iota(keys.begin(), keys.end(), 0);
 
-        std::array<std::byte, ValueSize> dummy_value;
-        for (int64_t iter = 0; iter != size; ++iter)
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(branchlessLowerBound(keys.data(), keys.size(), i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(BranchlessLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(BranchlessLowerBound)->Apply(LargeFlatSizes);
+
+template<size_t Width>
+static void SimdLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        std::vector<int64_t> keys(static_cast<size_t>(size));
+        std::iota(keys.begin(), keys.end(), 0);
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(simdLowerBound<Width>(keys.data(), keys.size(), i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.SetLabel(CountLessMode);
+}
+BENCHMARK_TEMPLATE(SimdLowerBound, 4)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(SimdLowerBound, 8)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(SimdLowerBound, 16)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(SimdLowerBound, 4)->Apply(LargeFlatSizes);
+BENCHMARK_TEMPLATE(SimdLowerBound, 8)->Apply(LargeFlatSizes);
+BENCHMARK_TEMPLATE(SimdLowerBound, 16)->Apply(LargeFlatSizes);
+
+// 64..2048 keys stay in L1, the larger sizes miss in L2, L3 and then DRAM,
+// which is where overlapping the searches pays
+static void BatchSizes(benchmark::internal::Benchmark* b)
+{
+        b->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+        for (int64_t size : { int64_t(1) << 16, int64_t(1) << 20, int64_t(1) << 23, int64_t(1) << 26 })
         {
-                M.emplace(iter, dummy_value);
-                pmrM.emplace(iter, dummy_value);
-                V.emplace_back(iter, dummy_value);
-                index.push_back(iter);
+                b->Arg(size);
         }
+}
 
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(index.begin(), index.end(), g);
-        return std::make_tuple(std::move(index), std::move(V), std::move(M), std::move(pmrM));
+template<size_t G>
+static void SortedVectorBatchedLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, keys] = makeSortedKeysAndIndex(size);
+        std::vector<size_t> out(index.size());
+
+        for (auto _ : state) {
+                lowerBoundBatch<G>(keys.data(), keys.size(), index.data(), index.size(), out.data());
+                benchmark::DoNotOptimize(out.data());
+                benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
 }
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 1)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 2)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 4)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 8)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 16)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(SortedVectorBatchedLowerBound, 32)->Apply(BatchSizes);
 
-static void StdVectorStdLowerBound(benchmark::State& state) {
+template<size_t G>
+static void StdMapBatchedLowerBound(benchmark::State& state) {
         const auto size = state.range(0);
+        auto [index, keys] = makeSortedKeysAndIndex(size);
+        std::map<int64_t, std::array<std::byte, 8>> M;
+        for (auto key : keys)
+        {
+                M.emplace_hint(M.end(), key, std::array<std::byte, 8>{});
+        }
+        std::vector<std::map<int64_t, std::array<std::byte, 8>>::const_iterator> out(index.size());
+
+        for (auto _ : state) {
+                lowerBoundBatch<G>(M, index.data(), index.size(), out.data());
+                benchmark::DoNotOptimize(out.data());
+                benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 1)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 2)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 4)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 8)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 16)->Apply(BatchSizes);
+BENCHMARK_TEMPLATE(StdMapBatchedLowerBound, 32)->Apply(BatchSizes);
 
+template<class Points>
+static void PointLookup(benchmark::State& state) {
+        const auto size = state.range(0);
         auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        Points points;
+        for (const auto& p : V)
+        {
+                points.insert(p.first, p.second);
+        }
 
         for (auto _ : state) {
                 for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(std::lower_bound(V.begin(), V.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                        benchmark::DoNotOptimize(points.find(i));
                 }
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.counters["bytes_per_entry"] = static_cast<double>(points.memoryBytes()) / static_cast<double>(size);
 }
-BENCHMARK(StdVectorStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointLookup, SortedVectorPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointLookup, StdMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointLookup, StdUnorderedMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointLookup, FlatHashPoints<40>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointLookup, FlatHashPoints<87>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
 
-static void StdMapMemberLowerBound(benchmark::State& state) {
+// inserts every key in shuffled order into an empty structure
+template<class Points>
+static void PointInsert(benchmark::State& state) {
         const auto size = state.range(0);
         auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const PointValue value{};
+        size_t bytes = 0;
 
         for (auto _ : state) {
+                state.PauseTiming();
+                auto points = std::make_unique<Points>();
+                state.ResumeTiming();
                 for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(M.lower_bound(i));
+                        points->insert(i, value);
                 }
+                state.PauseTiming();
+                bytes = points->memoryBytes();
+                points.reset();
+                state.ResumeTiming();
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.counters["bytes_per_entry"] = static_cast<double>(bytes) / static_cast<double>(size);
 }
-BENCHMARK(StdMapMemberLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointInsert, SortedVectorPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointInsert, StdMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointInsert, StdUnorderedMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointInsert, FlatHashPoints<40>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointInsert, FlatHashPoints<87>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
 
-static void PmrMapMemberLowerBound(benchmark::State& state) {
+// erases every key in shuffled order from a full structure
+template<class Points>
+static void PointErase(benchmark::State& state) {
         const auto size = state.range(0);
         auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        size_t bytes = 0;
 
         for (auto _ : state) {
+                state.PauseTiming();
+                auto points = std::make_unique<Points>();
+                for (const auto& p : V)
+                {
+                        points->insert(p.first, p.second);
+                }
+                bytes = points->memoryBytes();
+                state.ResumeTiming();
                 for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(pmrM.lower_bound(i));
+                        points->erase(i);
                 }
+                state.PauseTiming();
+                points.reset();
+                state.ResumeTiming();
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.counters["bytes_per_entry"] = static_cast<double>(bytes) / static_cast<double>(size);
 }
-BENCHMARK(PmrMapMemberLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointErase, SortedVectorPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointErase, StdMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointErase, StdUnorderedMapPoints)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointErase, FlatHashPoints<40>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK_TEMPLATE(PointErase, FlatHashPoints<87>)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
 
-static void StdMapStdLowerBound(benchmark::State& state) {
+// thread 0 builds the shared index and starts the writer before the loop,
+// the other threads only touch it once the loop's start barrier has passed
+template<class Index>
+static void ConcurrentReaders(benchmark::State& state, std::unique_ptr<Index>& shared, std::unique_ptr<BackgroundWriter<Index> >& writer) {
         const auto size = state.range(0);
-        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        std::mt19937_64 g{ static_cast<uint64_t>(state.thread_index()) };
+        std::uniform_int_distribution<int64_t> dist(0, size - 1);
+        std::vector<int64_t> lookups(ReaderLookupsPerIteration);
+        std::generate(lookups.begin(), lookups.end(), [&]() { return dist(g); });
+        std::array<std::byte, 8> value;
+
+        for (auto _ : state) {
+                for (auto i : lookups)
+                {
+                        benchmark::DoNotOptimize(shared->find(state.thread_index(), i, value));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * lookups.size());
+
+        if (state.thread_index() == 0)
+        {
+                writer->stop();
+                const auto& latencies = writer->latencies();
+                if (!latencies.empty())
+                {
+                        state.counters["writes"] = static_cast<double>(latencies.size());
+                        state.counters["writer_mean_us"] = std::accumulate(latencies.begin(), latencies.end(), 0.0) / static_cast<double>(latencies.size());
+                        state.counters["writer_max_us"] = *std::max_element(latencies.begin(), latencies.end());
+                }
+                writer.reset();
+                shared.reset();
+        }
+}
+
+static void RcuIndexConcurrentRead(benchmark::State& state) {
+        using Index = RcuSortedIndex<std::array<std::byte, 8> >;
+        static std::unique_ptr<Index> shared;
+        static std::unique_ptr<BackgroundWriter<Index> > writer;
+        if (state.thread_index() == 0)
+        {
+                auto [index, V, M, pmrM] = makeMapAndIndex<8>(state.range(0));
+                shared = std::make_unique<Index>(std::move(V));
+                writer = std::make_unique<BackgroundWriter<Index> >(*shared, state.range(0));
+        }
+        ConcurrentReaders(state, shared, writer);
+}
+BENCHMARK(RcuIndexConcurrentRead)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20)->ThreadRange(1, 8)->UseRealTime();
+
+static void SharedMutexMapConcurrentRead(benchmark::State& state) {
+        using Index = SharedMutexMap<std::array<std::byte, 8> >;
+        static std::unique_ptr<Index> shared;
+        static std::unique_ptr<BackgroundWriter<Index> > writer;
+        if (state.thread_index() == 0)
+        {
+                auto [index, V, M, pmrM] = makeMapAndIndex<8>(state.range(0));
+                shared = std::make_unique<Index>(std::move(M));
+                writer = std::make_unique<BackgroundWriter<Index> >(*shared, state.range(0));
+        }
+        ConcurrentReaders(state, shared, writer);
+}
+BENCHMARK(SharedMutexMapConcurrentRead)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20)->ThreadRange(1, 8)->UseRealTime();
+
+static void KeyDistributionArgs(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "dist", "sz" });
+        b->ArgsProduct({
+                { static_cast<int64_t>(KeyDistribution::Dense), static_cast<int64_t>(KeyDistribution::Gapped), static_cast<int64_t>(KeyDistribution::Clustered) },
+                { 1 << 10, 1 << 16, 1 << 20, 1 << 24 } });
+}
+
+static void StdVectorDistLowerBound(benchmark::State& state) {
+        const auto dist = static_cast<KeyDistribution>(state.range(0));
+        auto [index, keys] = makeDistributedKeysAndIndex(dist, state.range(1));
+        std::vector<std::pair<int64_t, std::array<std::byte, 8> > > V;
+        V.reserve(keys.size());
+        for (auto key : keys)
+        {
+                V.emplace_back(key, std::array<std::byte, 8>{});
+        }
 
         for (auto _ : state) {
                 for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(std::lower_bound(M.begin(), M.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                        benchmark::DoNotOptimize(std::lower_bound(V.begin(), V.end(), i, [](const auto& p, int64_t value)->bool { return p.first < value; }));
                 }
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.SetLabel(toString(dist));
 }
-BENCHMARK(StdMapStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdVectorDistLowerBound)->Apply(KeyDistributionArgs);
 
-static void PmrMapStdLowerBound(benchmark::State& state) {
-        const auto size = state.range(0);
-        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+static void StdMapDistLowerBound(benchmark::State& state) {
+        const auto dist = static_cast<KeyDistribution>(state.range(0));
+        auto [index, keys] = makeDistributedKeysAndIndex(dist, state.range(1));
+        std::map<int64_t, std::array<std::byte, 8> > M;
+        for (auto key : keys)
+        {
+                M.emplace_hint(M.end(), key, std::array<std::byte, 8>{});
+        }
 
         for (auto _ : state) {
                 for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(std::lower_bound(pmrM.begin(), pmrM.end(), i, [](const auto& p, int value)->bool { return p.first < value; }));
+                        benchmark::DoNotOptimize(M.lower_bound(i));
                 }
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.SetLabel(toString(dist));
 }
-BENCHMARK(PmrMapStdLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapDistLowerBound)->Apply(KeyDistributionArgs);
 
+static void LearnedIndexLowerBound(benchmark::State& state) {
+        const auto dist = static_cast<KeyDistribution>(state.range(0));
+        auto [index, keys] = makeDistributedKeysAndIndex(dist, state.range(1));
+        const LearnedIndex L(std::move(keys));
 
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(L.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.SetLabel(toString(dist));
+        state.counters["segments"] = static_cast<double>(L.segments());
+        state.counters["model_bytes"] = static_cast<double>(L.modelBytes());
+}
+BENCHMARK(LearnedIndexLowerBound)->Apply(KeyDistributionArgs);
 
+static void BPlusTreeLowerBound(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        BPlusTree<std::array<std::byte, 8> > T;
+        const std::array<std::byte, 8> value{};
+        for (int64_t key = 0; key != size; ++key)
+        {
+                T.insert(key, value);
+        }
 
-static void StdMapRead(benchmark::State& state) {
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(T.lower_bound(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(BPlusTreeLowerBound)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(BPlusTreeLowerBound)->Apply(LargeSizes);
+
+static void BPlusTreeRead(benchmark::State& state) {
+        const auto size = state.range(0);
+        BPlusTree<std::array<std::byte, 8> > T;
+        const std::array<std::byte, 8> value{};
+        for (int64_t key = 0; key != size; ++key)
+        {
+                T.insert(key, value);
+        }
+
+        for (auto _ : state) {
+                for (auto cursor = T.begin(); cursor.valid(); cursor.advance())
+                {
+                        benchmark::DoNotOptimize(cursor.key());
+                        benchmark::DoNotOptimize(cursor.value());
+                }
+        }
+}
+BENCHMARK(BPlusTreeRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(BPlusTreeRead)->Apply(LargeSizes);
+
+// insert heavy, every key of the shuffled index into an empty structure.
+// tearing it down isn't timed
+static void StdMapInsert(benchmark::State& state) {
         const auto size = state.range(0);
         auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const std::array<std::byte, 8> value{};
 
         for (auto _ : state) {
-                for (const auto& p : M)
+                std::map<int64_t, std::array<std::byte, 8> > W;
+                for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(p.first);
-                        benchmark::DoNotOptimize(p.second);
+                        W.emplace(i, value);
                 }
+                state.PauseTiming();
+                W.clear();
+                state.ResumeTiming();
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
 }
-BENCHMARK(StdMapRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapInsert)->RangeMultiplier(8)->Range(2 << 5, 2 << 20);
 
-static void PmrMapRead(benchmark::State& state) {
+static void PmrMapInsert(benchmark::State& state) {
         const auto size = state.range(0);
         auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const std::array<std::byte, 8> value{};
+        ArenaResource arena;
 
         for (auto _ : state) {
-                for (const auto& p : pmrM)
+                std::pmr::map<int64_t, std::array<std::byte, 8> > W(&arena);
+                for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(p.first);
-                        benchmark::DoNotOptimize(p.second);
+                        W.emplace(i, value);
                 }
+                state.PauseTiming();
+                W.clear();
+                state.ResumeTiming();
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
 }
-BENCHMARK(PmrMapRead)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PmrMapInsert)->RangeMultiplier(8)->Range(2 << 5, 2 << 20);
 
-static void StdMapReadFresh(benchmark::State& state) {
+static void BPlusTreeInsert(benchmark::State& state) {
         const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        const std::array<std::byte, 8> value{};
+
+        for (auto _ : state) {
+                auto T = std::make_unique<BPlusTree<std::array<std::byte, 8> > >();
+                for (auto i : index)
+                {
+                        T->insert(i, value);
+                }
+                state.PauseTiming();
+                T.reset();
+                state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(BPlusTreeInsert)->RangeMultiplier(8)->Range(2 << 5, 2 << 20);
 
+// erase heavy, the shuffled index out of a full structure. rebuilding it
+// isn't timed
+static void StdMapErase(benchmark::State& state) {
+        const auto size = state.range(0);
+        const auto index = makeLookupIndex(size);
+        std::map<int64_t, std::array<std::byte, 8> > W;
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+                W = makeStdMap<8>(size);
                 state.ResumeTiming();
-                for (const auto& p : M)
+                for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(p.first);
-                        benchmark::DoNotOptimize(p.second);
+                        W.erase(i);
                 }
+                benchmark::DoNotOptimize(W.size());
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
 }
-BENCHMARK(StdMapReadFresh)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(StdMapErase)->RangeMultiplier(8)->Range(2 << 5, 2 << 20);
 
-static void PmrMapReadFresh(benchmark::State& state) {
+static void BPlusTreeErase(benchmark::State& state) {
         const auto size = state.range(0);
-
+        const auto index = makeLookupIndex(size);
+        const std::array<std::byte, 8> value{};
+        std::unique_ptr<BPlusTree<std::array<std::byte, 8> > > T;
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+                T = std::make_unique<BPlusTree<std::array<std::byte, 8> > >();
+                for (int64_t key = 0; key != size; ++key)
+                {
+                        T->insert(key, value);
+                }
                 state.ResumeTiming();
-                for (const auto& p : pmrM)
+                for (auto i : index)
                 {
-                        benchmark::DoNotOptimize(p.first);
-                        benchmark::DoNotOptimize(p.second);
+                        T->erase(i);
                 }
+                benchmark::DoNotOptimize(T->size());
         }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK(BPlusTreeErase)->RangeMultiplier(8)->Range(2 << 5, 2 << 20);
+
+// L1 and L2 sized caches, 16 bytes an entry
+constexpr size_t L1HotKeySlots = 1 << 11;
+constexpr size_t L2HotKeySlots = 1 << 15;
+
+static void ZipfArgs(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "zipf_x100", "sz" });
+        b->ArgsProduct({ { 0, 50, 80, 99, 120 }, { 1 << 16, 1 << 20 } });
+}
+
+template<class Points>
+static void ZipfLookup(benchmark::State& state) {
+        const auto size = state.range(1);
+        const auto index = makeZipfIndex(size, static_cast<double>(state.range(0)) / 100);
+        Points points;
+        for (int64_t key = 0; key != size; ++key)
+        {
+                points.insert(key, PointValue{});
+        }
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(points.find(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK_TEMPLATE(ZipfLookup, SortedVectorPoints)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfLookup, StdMapPoints)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfLookup, FlatHashPoints<87>)->Apply(ZipfArgs);
+
+template<class Points, size_t Slots>
+static void ZipfCachedLookup(benchmark::State& state) {
+        const auto size = state.range(1);
+        const auto index = makeZipfIndex(size, static_cast<double>(state.range(0)) / 100);
+        Points points;
+        for (int64_t key = 0; key != size; ++key)
+        {
+                points.insert(key, PointValue{});
+        }
+        auto cache = std::make_unique<HotKeyCache<PointValue, Slots> >();
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(cache->find(i, [&](int64_t key) { return points.find(key); }));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+        state.counters["hit_rate"] = cache->hitRate();
+        state.counters["cache_bytes"] = static_cast<double>(cache->bytes());
+}
+BENCHMARK_TEMPLATE(ZipfCachedLookup, SortedVectorPoints, L1HotKeySlots)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfCachedLookup, SortedVectorPoints, L2HotKeySlots)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfCachedLookup, StdMapPoints, L1HotKeySlots)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfCachedLookup, StdMapPoints, L2HotKeySlots)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfCachedLookup, FlatHashPoints<87>, L1HotKeySlots)->Apply(ZipfArgs);
+BENCHMARK_TEMPLATE(ZipfCachedLookup, FlatHashPoints<87>, L2HotKeySlots)->Apply(ZipfArgs);
+
+constexpr size_t BloomBitsPerKey = 10;
+
+static void MissRatioArgs(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "miss_pct", "sz" });
+        b->ArgsProduct({ { 0, 50, 90, 99 }, { 1 << 16, 1 << 20 } });
+}
+
+template<class Points>
+static void MissLookup(benchmark::State& state) {
+        const auto size = state.range(1);
+        const auto index = makeMissIndex(size, static_cast<double>(state.range(0)) / 100);
+        Points points;
+        for (int64_t key = 0; key != size; ++key)
+        {
+                points.insert(2 * key, PointValue{});
+        }
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(points.find(i));
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+}
+BENCHMARK_TEMPLATE(MissLookup, SortedVectorPoints)->Apply(MissRatioArgs);
+BENCHMARK_TEMPLATE(MissLookup, StdMapPoints)->Apply(MissRatioArgs);
+
+// the false positive rate is measured on odd keys outside the timed loop
+template<class Points>
+static void FilteredMissLookup(benchmark::State& state) {
+        const auto size = state.range(1);
+        const auto index = makeMissIndex(size, static_cast<double>(state.range(0)) / 100);
+        Points points;
+        BlockedBloomFilter filter(static_cast<size_t>(size), BloomBitsPerKey);
+        for (int64_t key = 0; key != size; ++key)
+        {
+                points.insert(2 * key, PointValue{});
+                filter.insert(2 * key);
+        }
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        benchmark::DoNotOptimize(filter.mayContain(i) ? points.find(i) : nullptr);
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * index.size());
+
+        const auto misses = makeMissIndex(size, 1.0);
+        const auto falsePositives = std::count_if(misses.begin(), misses.end(), [&](int64_t key) { return filter.mayContain(key); });
+        state.counters["filter_bytes"] = static_cast<double>(filter.bytes());
+        state.counters["bits_per_key"] = static_cast<double>(filter.bytes() * 8) / static_cast<double>(size);
+        state.counters["fpr"] = static_cast<double>(falsePositives) / static_cast<double>(misses.size());
+}
+BENCHMARK_TEMPLATE(FilteredMissLookup, SortedVectorPoints)->Apply(MissRatioArgs);
+BENCHMARK_TEMPLATE(FilteredMissLookup, StdMapPoints)->Apply(MissRatioArgs);
+
+// per operation versions of the lookup loops, only registered with
+// --latency_histograms
+static void StdVectorStdLowerBoundLatency(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        LatencyHistogram histogram;
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        timeOperation(histogram, [&]() { benchmark::DoNotOptimize(std::lower_bound(V.begin(), V.end(), i, [](const auto& p, int64_t value)->bool { return p.first < value; })); });
+                }
+        }
+        reportLatency(state, histogram, "StdVectorStdLowerBound/" + std::to_string(size));
+}
+
+static void StdMapMemberLowerBoundLatency(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        LatencyHistogram histogram;
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        timeOperation(histogram, [&]() { benchmark::DoNotOptimize(M.lower_bound(i)); });
+                }
+        }
+        reportLatency(state, histogram, "StdMapMemberLowerBound/" + std::to_string(size));
+}
+
+static void PmrMapMemberLowerBoundLatency(benchmark::State& state) {
+        const auto size = state.range(0);
+        auto [index, V, M, pmrM] = makeMapAndIndex<8>(size);
+        LatencyHistogram histogram;
+
+        for (auto _ : state) {
+                for (auto i : index)
+                {
+                        timeOperation(histogram, [&]() { benchmark::DoNotOptimize(pmrM.lower_bound(i)); });
+                }
+        }
+        reportLatency(state, histogram, "PmrMapMemberLowerBound/" + std::to_string(size));
 }
-BENCHMARK(PmrMapReadFresh)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
 
-BENCHMARK_MAIN();
+static void registerLatencyBenchmarks()
+{
+        benchmark::RegisterBenchmark("StdVectorStdLowerBoundLatency", StdVectorStdLowerBoundLatency)->RangeMultiplier(8)->Range(2 << 5, 1 << 20);
+        benchmark::RegisterBenchmark("StdMapMemberLowerBoundLatency", StdMapMemberLowerBoundLatency)->RangeMultiplier(8)->Range(2 << 5, 1 << 20);
+        benchmark::RegisterBenchmark("PmrMapMemberLowerBoundLatency", PmrMapMemberLowerBoundLatency)->RangeMultiplier(8)->Range(2 << 5, 1 << 20);
+}
 
+// branch misses are reported by default, they are the difference between
+// std::lower_bound and the branchless searches.
+// --latency_histograms[=file] adds the per operation latency benchmarks
+int main(int argc, char** argv)
+{
+        std::vector<char*> args(argv, argv + argc);
+        const bool latencyHistograms = takeLatencyHistogramsFlag(args);
+        if (latencyHistograms)
+        {
+                registerLatencyBenchmarks();
+        }
+        const int result = runWithPerfCounters(args, "BRANCH-MISSES");
+        if (result == 0 && latencyHistograms)
+        {
+                writeLatencyDump();
+        }
+        return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// runs the registered benchmarks with --benchmark_perf_counters=<counters>
+// unless the command line already names its own. needs google benchmark
+// built with libpfm, otherwise the library just warns and carries on
+inline int runWithPerfCounters(std::vector<char*> args, const std::string& counters)
+{
+        std::string perfCounters = "--benchmark_perf_counters=" + counters;
+        const bool userCounters = std::any_of(args.begin(), args.end(), [](const char* arg) {
+                return std::strncmp(arg, "--benchmark_perf_counters", 25) == 0; });
+        if (!userCounters)
+        {
+                args.push_back(perfCounters.data());
+        }
+        int count = static_cast<int>(args.size());
+        args.push_back(nullptr);
+        benchmark::Initialize(&count, args.data());
+        if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+        {
+                return 1;
+        }
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+        return 0;
+}
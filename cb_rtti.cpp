@@ -8,6 +8,104 @@
 #include <utility>
 #include <iterator>
 #include <random>
+#include <cstdint>
+#include <type_traits>
+#include <string>
+#include <functional>
+#include <numeric>
+#include <cstring>
+#include <memory_resource>
+
+#include "cb_perf_counters.h"
+
+// opt-in constant time type tests. the hierarchy is spelled out once as a
+// tree of types, every class gets its preorder number as an id, and the ids
+// of a subtree are contiguous, so is_a is a single range check
+struct TypeIdRange
+{
+        uint32_t first;
+        uint32_t count;
+        constexpr bool contains(uint32_t id)const { return id - first < count; }
+};
+
+template<class Root, class... Children>
+struct TypeHierarchy
+{
+        static constexpr uint32_t size = 1 + (0 + ... + Children::size);
+
+        template<class T>
+        static constexpr bool containsType()
+        {
+                return std::is_same_v<T, Root> || (... || Children::template containsType<T>());
+        }
+
+        template<class T>
+        static constexpr TypeIdRange rangeOf(uint32_t first = 0)
+        {
+                static_assert(containsType<T>(), "type is not part of the hierarchy");
+                if constexpr (std::is_same_v<T, Root>)
+                {
+                        return TypeIdRange{ first, size };
+                }
+                else
+                {
+                        TypeIdRange result{ 0, 0 };
+                        uint32_t next = first + 1;
+                        (..., searchChild<T, Children>(result, next));
+                        return result;
+                }
+        }
+private:
+        template<class T, class Child>
+        static constexpr void searchChild(TypeIdRange& result, uint32_t& next)
+        {
+                if constexpr (Child::template containsType<T>())
+                {
+                        result = Child::template rangeOf<T>(next);
+                }
+                next += Child::size;
+        }
+};
+
+struct FastRttiObject
+{
+        uint32_t fastTypeId = 0;
+};
+
+// each class in the hierarchy derives through this, the most derived
+// constructor runs last so the object ends up with its own id
+template<class Self, class Parent>
+struct FastRttiDerive : Parent
+{
+        FastRttiDerive()
+        {
+                this->fastTypeId = Parent::FastRttiHierarchy::template rangeOf<Self>().first;
+        }
+};
+
+template<class T, class U>
+bool is_a(const U* ptr)
+{
+        constexpr auto range = std::remove_const_t<T>::FastRttiHierarchy::template rangeOf<std::remove_const_t<T>>();
+        return ptr != nullptr && range.contains(ptr->fastTypeId);
+}
+
+template<class T, class U>
+T* fast_cast(U* ptr)
+{
+        return is_a<T>(ptr) ? static_cast<T*>(ptr) : nullptr;
+}
+
+template<class T, class U>
+std::shared_ptr<T> fast_pointer_cast(const std::shared_ptr<U>& ptr)
+{
+        if (is_a<T>(ptr.get()))
+        {
+                return std::shared_ptr<T>(ptr, static_cast<T*>(ptr.get()));
+        }
+        return {};
+}
+
 
 struct Base
 {
@@ -19,31 +117,148 @@ struct A : Base{virtual bool IsA()const{ return true; }};
 struct B : Base{};
 struct C : Base{};
 
+// the same shape with the opt-in ids. kept apart so the dynamic_cast
+// benchmarks still run on the original layout and depth
+struct FastBase;
+struct FastA;
+struct FastB;
+struct FastC;
+using FastBaseHierarchy = TypeHierarchy<FastBase, TypeHierarchy<FastA>, TypeHierarchy<FastB>, TypeHierarchy<FastC> >;
 
-std::vector<Base*> make_random_vec()
+struct FastBase : FastRttiObject
 {
-        constexpr size_t size = 10000;
-        std::vector<Base*> vec;
-        for (size_t idx = 0; idx != size; ++idx)
+        using FastRttiHierarchy = FastBaseHierarchy;
+        FastBase() { fastTypeId = FastBaseHierarchy::rangeOf<FastBase>().first; }
+        virtual ~FastBase()=default;
+        virtual bool IsA()const{ return false; }
+};
+
+struct FastA : FastRttiDerive<FastA, FastBase>{virtual bool IsA()const{ return true; }};
+struct FastB : FastRttiDerive<FastB, FastBase>{};
+struct FastC : FastRttiDerive<FastC, FastBase>{};
+
+static_assert(FastBaseHierarchy::rangeOf<FastBase>().count == 4, "FastBase covers the whole tree");
+static_assert(FastBaseHierarchy::rangeOf<FastB>().first == 2 && FastBaseHierarchy::rangeOf<FastB>().count == 1, "preorder numbering");
+
+
+// where the objects behind make_random_vec live. the kind sequence is always
+// shuffled, the layouts only differ in how the walk touches memory
+//   Heap          - one new per object, pointers shuffled, the original layout
+//   ArenaSorted   - contiguous arena, walked in address order
+//   ArenaShuffled - contiguous arena, walked in shuffled order
+enum class ObjectLayout
+{
+        Heap,
+        ArenaSorted,
+        ArenaShuffled,
+};
+
+static const char* toString(ObjectLayout layout)
+{
+        switch (layout)
         {
-                vec.push_back(new A{});
-                vec.push_back(new B{});
-                vec.push_back(new C{});
+        case ObjectLayout::Heap: return "heap";
+        case ObjectLayout::ArenaSorted: return "arena_sorted";
+        case ObjectLayout::ArenaShuffled: return "arena_shuffled";
+        default:
+                throw std::domain_error("unknown layout");
         }
+}
+
+// objects allocated from a monotonic buffer, which hands back its memory in
+// one go, so their destructors are run first
+template<class Root>
+struct ObjectArena
+{
+        explicit ObjectArena(size_t bytes)
+                : resource(bytes)
+        {}
+        ~ObjectArena()
+        {
+                for (Root* ptr : objects)
+                {
+                        std::destroy_at(ptr);
+                }
+        }
+        std::pmr::monotonic_buffer_resource resource;
+        std::vector<Root*> objects;
+};
+
+template<class Root>
+struct RandomObjects
+{
+        std::unique_ptr<ObjectArena<Root> > arena;
+        std::vector<std::unique_ptr<Root> > owned;
+        std::vector<Root*> vec;
+};
+
+// size is the number of objects of each kind
+template<class Root, class KindA, class KindB, class KindC>
+RandomObjects<Root> make_random_vec(ObjectLayout layout = ObjectLayout::Heap, size_t size = 10000)
+{
         std::random_device rd;
         std::mt19937 g(rd());
-        std::shuffle(std::begin(vec),std::end(vec),g);
-        return vec;
+
+        std::vector<int> kinds;
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                kinds.push_back(0);
+                kinds.push_back(1);
+                kinds.push_back(2);
+        }
+        std::shuffle(std::begin(kinds), std::end(kinds), g);
+
+        RandomObjects<Root> result;
+        if (layout == ObjectLayout::Heap)
+        {
+                for (int kind : kinds)
+                {
+                        switch (kind)
+                        {
+                        case 0: result.owned.push_back(std::make_unique<KindA>()); break;
+                        case 1: result.owned.push_back(std::make_unique<KindB>()); break;
+                        case 2: result.owned.push_back(std::make_unique<KindC>()); break;
+                        }
+                        result.vec.push_back(result.owned.back().get());
+                }
+        }
+        else
+        {
+                result.arena = std::make_unique<ObjectArena<Root> >(kinds.size() * std::max({ sizeof(KindA), sizeof(KindB), sizeof(KindC) }));
+                std::pmr::polymorphic_allocator<> alloc{ &result.arena->resource };
+                for (int kind : kinds)
+                {
+                        switch (kind)
+                        {
+                        case 0: result.arena->objects.push_back(alloc.new_object<KindA>()); break;
+                        case 1: result.arena->objects.push_back(alloc.new_object<KindB>()); break;
+                        case 2: result.arena->objects.push_back(alloc.new_object<KindC>()); break;
+                        }
+                        result.vec.push_back(result.arena->objects.back());
+                }
+        }
+        if (layout != ObjectLayout::ArenaSorted)
+        {
+                std::shuffle(std::begin(result.vec), std::end(result.vec), g);
+        }
+        return result;
+}
+
+static void ObjectLayouts(benchmark::internal::Benchmark* b)
+{
+        // 30k objects stay cache resident, 3M don't
+        b->ArgNames({ "layout", "objects" })->ArgsProduct({ { 0, 1, 2 }, { 30000, 3000000 } });
 }
-std::vector<std::shared_ptr<Base> > make_random_shared_vec()
+template<class Root, class KindA, class KindB, class KindC>
+std::vector<std::shared_ptr<Root> > make_random_shared_vec()
 {
         constexpr size_t size = 10000;
-        std::vector<std::shared_ptr<Base> > vec;
+        std::vector<std::shared_ptr<Root> > vec;
         for (size_t idx = 0; idx != size; ++idx)
         {
-                vec.push_back(std::make_shared<A>());
-                vec.push_back(std::make_shared<B>());
-                vec.push_back(std::make_shared<C>());
+                vec.push_back(std::make_shared<KindA>());
+                vec.push_back(std::make_shared<KindB>());
+                vec.push_back(std::make_shared<KindC>());
         }
         std::random_device rd;
         std::mt19937 g(rd());
@@ -51,14 +266,18 @@ std::vector<std::shared_ptr<Base> > make_random_shared_vec()
         return vec;
 }
 static void NoRTTITest(benchmark::State& state) {
+    const auto layout = static_cast<ObjectLayout>(state.range(0));
+    const auto perKind = static_cast<size_t>(state.range(1)) / 3;
+    // kept outside the loop so the previous set is destroyed while paused
+    RandomObjects<Base> objects;
     for (auto _ : state)
     {
         state.PauseTiming();
-        const auto vec = make_random_vec();
+        objects = make_random_vec<Base, A, B, C>(layout, perKind);
         state.ResumeTiming();
 
         size_t counter = 0;
-        for (auto const& x : vec)
+        for (auto const& x : objects.vec)
         {
                 if (x->IsA())
                 {
@@ -67,17 +286,21 @@ static void NoRTTITest(benchmark::State& state) {
         }
         benchmark::DoNotOptimize(counter);
     }
+    state.SetLabel(toString(layout));
 }
-BENCHMARK(NoRTTITest);
+BENCHMARK(NoRTTITest)->Apply(ObjectLayouts);
 static void DynCastPtr(benchmark::State& state) {
+    const auto layout = static_cast<ObjectLayout>(state.range(0));
+    const auto perKind = static_cast<size_t>(state.range(1)) / 3;
+    RandomObjects<Base> objects;
     for (auto _ : state)
     {
         state.PauseTiming();
-        const auto vec = make_random_vec();
+        objects = make_random_vec<Base, A, B, C>(layout, perKind);
         state.ResumeTiming();
 
         size_t counter = 0;
-        for (auto const& x : vec)
+        for (auto const& x : objects.vec)
         {
                 if (dynamic_cast<const A*>(x))
                 {
@@ -86,13 +309,14 @@ static void DynCastPtr(benchmark::State& state) {
         }
         benchmark::DoNotOptimize(counter);
     }
+    state.SetLabel(toString(layout));
 }
-BENCHMARK(DynCastPtr);
+BENCHMARK(DynCastPtr)->Apply(ObjectLayouts);
 static void DynCastSharedPtr(benchmark::State& state) {
     for (auto _ : state)
     {
         state.PauseTiming();
-        const auto vec = make_random_shared_vec();
+        const auto vec = make_random_shared_vec<Base, A, B, C>();
         state.ResumeTiming();
 
         size_t counter = 0;
@@ -108,5 +332,379 @@ static void DynCastSharedPtr(benchmark::State& state) {
 }
 BENCHMARK(DynCastSharedPtr);
 
-BENCHMARK_MAIN();
+static void FastIsA(benchmark::State& state) {
+    const auto layout = static_cast<ObjectLayout>(state.range(0));
+    const auto perKind = static_cast<size_t>(state.range(1)) / 3;
+    RandomObjects<FastBase> objects;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        objects = make_random_vec<FastBase, FastA, FastB, FastC>(layout, perKind);
+        state.ResumeTiming();
+
+        size_t counter = 0;
+        for (auto const& x : objects.vec)
+        {
+                if (is_a<const FastA>(x))
+                {
+                        ++counter;
+                }
+        }
+        benchmark::DoNotOptimize(counter);
+    }
+    state.SetLabel(toString(layout));
+}
+BENCHMARK(FastIsA)->Apply(ObjectLayouts);
+static void FastCastPtr(benchmark::State& state) {
+    const auto layout = static_cast<ObjectLayout>(state.range(0));
+    const auto perKind = static_cast<size_t>(state.range(1)) / 3;
+    RandomObjects<FastBase> objects;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        objects = make_random_vec<FastBase, FastA, FastB, FastC>(layout, perKind);
+        state.ResumeTiming();
+
+        size_t counter = 0;
+        for (auto const& x : objects.vec)
+        {
+                if (fast_cast<const FastA>(x))
+                {
+                        ++counter;
+                }
+        }
+        benchmark::DoNotOptimize(counter);
+    }
+    state.SetLabel(toString(layout));
+}
+BENCHMARK(FastCastPtr)->Apply(ObjectLayouts);
+static void FastCastSharedPtr(benchmark::State& state) {
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vec = make_random_shared_vec<FastBase, FastA, FastB, FastC>();
+        state.ResumeTiming();
+
+        size_t counter = 0;
+        for (auto const& x : vec)
+        {
+                if (fast_pointer_cast<const FastA>(x))
+                {
+                        ++counter;
+                }
+        }
+        benchmark::DoNotOptimize(counter);
+    }
+}
+BENCHMARK(FastCastSharedPtr);
+
+
+// generated hierarchies for measuring how dynamic_cast scales with shape.
+// each family is a chain of Depth levels below GenRoot, with FanOut sibling
+// leaves hanging off the bottom level
+//   single   - plain single inheritance
+//   multiple - every level also derives from its own polymorphic mixin
+//   virtual  - as multiple, but all bases are virtual
+struct GenRoot
+{
+        virtual ~GenRoot() = default;
+};
+template<size_t I>
+struct GenMixin
+{
+        virtual ~GenMixin() = default;
+        size_t mixin = I;
+};
+
+template<size_t Depth>
+struct SingleLevel : SingleLevel<Depth - 1> {};
+template<>
+struct SingleLevel<0> : GenRoot {};
+
+template<size_t Depth>
+struct MultipleLevel : MultipleLevel<Depth - 1>, GenMixin<Depth> {};
+template<>
+struct MultipleLevel<0> : GenRoot, GenMixin<0> {};
+
+template<size_t Depth>
+struct VirtualLevel : virtual VirtualLevel<Depth - 1>, virtual GenMixin<Depth> {};
+template<>
+struct VirtualLevel<0> : virtual GenRoot, virtual GenMixin<0> {};
+
+template<template<size_t> class Level, size_t Depth, size_t Tag>
+struct GenLeaf : Level<Depth> {};
+
+struct GenObjects
+{
+        std::vector<std::unique_ptr<GenRoot> > owner;
+        std::vector<const GenRoot*> roots;
+        std::vector<const void*> mixins;
+};
+
+// shuffled leaves of FanOut different types, as GenRoot* and, where the
+// family has one, as the GenMixin<0>* used for cross casts
+template<template<size_t> class Level, size_t Depth, size_t... Tag>
+GenObjects makeGenObjects(size_t size, std::index_sequence<Tag...>)
+{
+        constexpr bool HasMixin = std::is_base_of_v<GenMixin<0>, Level<Depth> >;
+        using Factory = std::unique_ptr<GenRoot>(*)(const void*&);
+        static const Factory factories[] = { [](const void*& mixin) -> std::unique_ptr<GenRoot> {
+                auto leaf = std::make_unique<GenLeaf<Level, Depth, Tag> >();
+                if constexpr (HasMixin)
+                {
+                        mixin = static_cast<const GenMixin<0>*>(leaf.get());
+                }
+                return leaf;
+        }... };
+
+        GenObjects result;
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                const void* mixin = nullptr;
+                result.owner.push_back(factories[idx % sizeof...(Tag)](mixin));
+                result.roots.push_back(result.owner.back().get());
+                result.mixins.push_back(mixin);
+        }
+        std::vector<size_t> order(size);
+        std::iota(order.begin(), order.end(), size_t{ 0 });
+        std::shuffle(order.begin(), order.end(), std::mt19937{ 42 });
+        GenObjects shuffled;
+        for (size_t idx : order)
+        {
+                shuffled.owner.push_back(std::move(result.owner[idx]));
+                shuffled.roots.push_back(result.roots[idx]);
+                shuffled.mixins.push_back(result.mixins[idx]);
+        }
+        return shuffled;
+}
+
+constexpr size_t GenObjectCount = 30000;
+
+// every object is a Level<Depth>, so this always succeeds
+template<template<size_t> class Level, size_t Depth, size_t FanOut>
+static void GenDynCastDown(benchmark::State& state) {
+        const auto objects = makeGenObjects<Level, Depth>(GenObjectCount, std::make_index_sequence<FanOut>{});
+        for (auto _ : state)
+        {
+                size_t counter = 0;
+                for (const GenRoot* x : objects.roots)
+                {
+                        if (dynamic_cast<const Level<Depth>*>(x))
+                        {
+                                ++counter;
+                        }
+                }
+                benchmark::DoNotOptimize(counter);
+        }
+        state.SetItemsProcessed(state.iterations() * GenObjectCount);
+}
+
+// the target is a sibling leaf that is never instantiated, so every cast
+// has to search the whole hierarchy before failing
+template<template<size_t> class Level, size_t Depth, size_t FanOut>
+static void GenDynCastFailed(benchmark::State& state) {
+        const auto objects = makeGenObjects<Level, Depth>(GenObjectCount, std::make_index_sequence<FanOut>{});
+        for (auto _ : state)
+        {
+                size_t counter = 0;
+                for (const GenRoot* x : objects.roots)
+                {
+                        if (dynamic_cast<const GenLeaf<Level, Depth, FanOut>*>(x))
+                        {
+                                ++counter;
+                        }
+                }
+                benchmark::DoNotOptimize(counter);
+        }
+        state.SetItemsProcessed(state.iterations() * GenObjectCount);
+}
 
+// from the GenMixin<0> sub-object across to its sibling base GenRoot. the
+// target isn't a base or derived class of the source, so the runtime has to
+// go to the most derived object and search its whole hierarchy
+template<template<size_t> class Level, size_t Depth, size_t FanOut>
+static void GenDynCastCross(benchmark::State& state) {
+        const auto objects = makeGenObjects<Level, Depth>(GenObjectCount, std::make_index_sequence<FanOut>{});
+        for (auto _ : state)
+        {
+                size_t counter = 0;
+                for (const void* x : objects.mixins)
+                {
+                        if (dynamic_cast<const GenRoot*>(static_cast<const GenMixin<0>*>(x)))
+                        {
+                                ++counter;
+                        }
+                }
+                benchmark::DoNotOptimize(counter);
+        }
+        state.SetItemsProcessed(state.iterations() * GenObjectCount);
+}
+
+template<template<size_t> class Level, size_t Depth, size_t... FanOut>
+void registerGenShape(const std::string& shape)
+{
+        const std::string suffix = "/" + shape + "/depth:" + std::to_string(Depth);
+        (..., benchmark::RegisterBenchmark(("GenDynCastDown" + suffix + "/fanout:" + std::to_string(FanOut)).c_str(), GenDynCastDown<Level, Depth, FanOut>));
+        (..., benchmark::RegisterBenchmark(("GenDynCastFailed" + suffix + "/fanout:" + std::to_string(FanOut)).c_str(), GenDynCastFailed<Level, Depth, FanOut>));
+        if constexpr (std::is_base_of_v<GenMixin<0>, Level<Depth> >)
+        {
+                (..., benchmark::RegisterBenchmark(("GenDynCastCross" + suffix + "/fanout:" + std::to_string(FanOut)).c_str(), GenDynCastCross<Level, Depth, FanOut>));
+        }
+}
+
+template<template<size_t> class Level, size_t... Depth>
+void registerGenFamily(const std::string& shape)
+{
+        (..., registerGenShape<Level, Depth, 1, 4, 16>(shape));
+}
+
+static const bool GenHierarchiesRegistered = [] {
+        registerGenFamily<SingleLevel, 1, 2, 4, 8, 16>("single");
+        registerGenFamily<MultipleLevel, 1, 2, 4, 8, 16>("multiple");
+        registerGenFamily<VirtualLevel, 1, 2, 4, 8, 16>("virtual");
+        return true;
+}();
+
+
+// megamorphic call site, K concrete handlers each with its own body, called
+// through one virtual call site over a shuffled array. compared with a
+// switch on a type tag and a table of function pointers doing the same work
+template<size_t I>
+uint64_t handlerBody(uint64_t x)
+{
+        for (int round = 0; round != 4; ++round)
+        {
+                x ^= x >> (I % 29 + 3);
+                x *= 0x9E3779B97F4A7C15ull + 2 * I;
+        }
+        return x + I;
+}
+
+struct Handler
+{
+        virtual ~Handler() = default;
+        virtual uint64_t handle(uint64_t x)const = 0;
+        uint32_t tag = 0;
+};
+
+template<size_t I>
+struct HandlerImpl final : Handler
+{
+        HandlerImpl() { tag = I; }
+        uint64_t handle(uint64_t x)const override { return handlerBody<I>(x); }
+};
+
+constexpr size_t MaxHandlers = 256;
+
+#define CB_HANDLER_CASE(N) case N: if constexpr ((N) < K) { return handlerBody<(N)>(x); } else { break; }
+#define CB_HANDLER_CASE4(N) CB_HANDLER_CASE(N) CB_HANDLER_CASE(N + 1) CB_HANDLER_CASE(N + 2) CB_HANDLER_CASE(N + 3)
+#define CB_HANDLER_CASE16(N) CB_HANDLER_CASE4(N) CB_HANDLER_CASE4(N + 4) CB_HANDLER_CASE4(N + 8) CB_HANDLER_CASE4(N + 12)
+#define CB_HANDLER_CASE64(N) CB_HANDLER_CASE16(N) CB_HANDLER_CASE16(N + 16) CB_HANDLER_CASE16(N + 32) CB_HANDLER_CASE16(N + 48)
+
+template<size_t K>
+uint64_t switchHandle(uint32_t tag, uint64_t x)
+{
+        static_assert(K <= MaxHandlers, "switch only has MaxHandlers cases");
+        switch (tag)
+        {
+        CB_HANDLER_CASE64(0)
+        CB_HANDLER_CASE64(64)
+        CB_HANDLER_CASE64(128)
+        CB_HANDLER_CASE64(192)
+        }
+        throw std::domain_error("unknown handler");
+}
+
+#undef CB_HANDLER_CASE64
+#undef CB_HANDLER_CASE16
+#undef CB_HANDLER_CASE4
+#undef CB_HANDLER_CASE
+
+template<size_t... I>
+uint64_t tableHandle(uint32_t tag, uint64_t x, std::index_sequence<I...>)
+{
+        using Fn = uint64_t(*)(uint64_t);
+        static constexpr Fn table[] = { &handlerBody<I>... };
+        return table[tag](x);
+}
+
+template<size_t... I>
+std::vector<std::unique_ptr<Handler> > makeHandlers(size_t size, std::index_sequence<I...>)
+{
+        using Factory = std::unique_ptr<Handler>(*)();
+        static constexpr Factory factories[] = { []() -> std::unique_ptr<Handler> { return std::make_unique<HandlerImpl<I> >(); }... };
+        std::vector<std::unique_ptr<Handler> > result;
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                result.push_back(factories[idx % sizeof...(I)]());
+        }
+        std::shuffle(result.begin(), result.end(), std::mt19937{ 42 });
+        return result;
+}
+
+constexpr size_t HandlerCount = 30000;
+
+template<size_t K>
+static void MegamorphicVirtual(benchmark::State& state) {
+        const auto handlers = makeHandlers(HandlerCount, std::make_index_sequence<K>{});
+        for (auto _ : state)
+        {
+                uint64_t acc = 0;
+                for (const auto& h : handlers)
+                {
+                        acc += h->handle(acc);
+                }
+                benchmark::DoNotOptimize(acc);
+        }
+        state.SetItemsProcessed(state.iterations() * HandlerCount);
+}
+
+template<size_t K>
+static void MegamorphicSwitch(benchmark::State& state) {
+        const auto handlers = makeHandlers(HandlerCount, std::make_index_sequence<K>{});
+        for (auto _ : state)
+        {
+                uint64_t acc = 0;
+                for (const auto& h : handlers)
+                {
+                        acc += switchHandle<K>(h->tag, acc);
+                }
+                benchmark::DoNotOptimize(acc);
+        }
+        state.SetItemsProcessed(state.iterations() * HandlerCount);
+}
+
+template<size_t K>
+static void MegamorphicFnTable(benchmark::State& state) {
+        const auto handlers = makeHandlers(HandlerCount, std::make_index_sequence<K>{});
+        for (auto _ : state)
+        {
+                uint64_t acc = 0;
+                for (const auto& h : handlers)
+                {
+                        acc += tableHandle(h->tag, acc, std::make_index_sequence<K>{});
+                }
+                benchmark::DoNotOptimize(acc);
+        }
+        state.SetItemsProcessed(state.iterations() * HandlerCount);
+}
+
+template<size_t... K>
+void registerMegamorphic()
+{
+        (..., benchmark::RegisterBenchmark(("MegamorphicVirtual/targets:" + std::to_string(K)).c_str(), MegamorphicVirtual<K>));
+        (..., benchmark::RegisterBenchmark(("MegamorphicSwitch/targets:" + std::to_string(K)).c_str(), MegamorphicSwitch<K>));
+        (..., benchmark::RegisterBenchmark(("MegamorphicFnTable/targets:" + std::to_string(K)).c_str(), MegamorphicFnTable<K>));
+}
+
+static const bool MegamorphicRegistered = [] {
+        registerMegamorphic<2, 4, 8, 16, 32, 64, 128, 256>();
+        return true;
+}();
+
+// branch and icache misses are reported by default, they are what the
+// megamorphic benchmarks are about
+int main(int argc, char** argv)
+{
+        return runWithPerfCounters(std::vector<char*>(argv, argv + argc), "BRANCH-MISSES,L1-ICACHE-LOAD-MISSES");
+}
@@ -12,6 +12,23 @@
 #include <array>
 #include <memory_resource>
 #include <variant>
+#include <tuple>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <bit>
+
+#include "cb_latency.h"
+#include "cb_perf_counters.h"
+
+#ifdef _MSC_VER
+#define CB_NOINLINE __declspec(noinline)
+#else
+#define CB_NOINLINE [[gnu::noinline]]
+#endif
 
 enum class Kind
 {
@@ -36,13 +53,71 @@ struct Double : Base
 };
 
 
-static std::vector<std::shared_ptr<Base> > makePolyVector(size_t sz)
+
+// order in which the generators below produce Int and Double. alternating
+// is what the branch predictor learns perfectly, the others are closer to
+// a real event stream
+enum class TypeMix
 {
-        std::vector<std::shared_ptr<Base>> result(0);
+        Alternating,
+        Uniform,
+        Skewed,
+        Runs,
+};
+
+static const char* toString(TypeMix mix)
+{
+        switch (mix)
+        {
+        case TypeMix::Alternating: return "alternating";
+        case TypeMix::Uniform: return "uniform";
+        case TypeMix::Skewed: return "skewed_95_5";
+        case TypeMix::Runs: return "runs";
+        default:
+                throw std::domain_error("unknown mix");
+        }
+}
+
+static std::vector<Kind> makeKindSequence(size_t sz, TypeMix mix, size_t runLength = 16)
+{
+        std::mt19937 g(42);
+        std::vector<Kind> result;
         result.reserve(sz);
         for (size_t idx = 0; idx != sz; ++idx)
         {
-                if (idx % 2 == 0)
+                switch (mix)
+                {
+                case TypeMix::Alternating:
+                        result.push_back(idx % 2 == 0 ? Kind::Int : Kind::Double);
+                        break;
+                case TypeMix::Uniform:
+                        result.push_back(g() % 2 == 0 ? Kind::Int : Kind::Double);
+                        break;
+                case TypeMix::Skewed:
+                        result.push_back(g() % 100 < 95 ? Kind::Int : Kind::Double);
+                        break;
+                case TypeMix::Runs:
+                        if (idx % runLength == 0)
+                        {
+                                result.push_back(g() % 2 == 0 ? Kind::Int : Kind::Double);
+                        }
+                        else
+                        {
+                                result.push_back(result.back());
+                        }
+                        break;
+                }
+        }
+        return result;
+}
+
+static std::vector<std::shared_ptr<Base> > makePolyVector(const std::vector<Kind>& kinds)
+{
+        std::vector<std::shared_ptr<Base>> result(0);
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
+        {
+                if (kinds[idx] == Kind::Int)
                 {
                         result.push_back(std::make_shared<Int>(idx));
                 }
@@ -53,16 +128,20 @@ static std::vector<std::shared_ptr<Base> > makePolyVector(size_t sz)
         }
         return result;
 }
+static std::vector<std::shared_ptr<Base> > makePolyVector(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makePolyVector(makeKindSequence(sz, mix));
+}
 
-static std::vector<std::shared_ptr<Base> > makePolyPmrSharedVector(std::pmr::memory_resource* resource, size_t sz)
+static std::vector<std::shared_ptr<Base> > makePolyPmrSharedVector(std::pmr::memory_resource* resource, const std::vector<Kind>& kinds)
 {
         std::pmr::polymorphic_allocator<Int> intAlloc{ resource };
         std::pmr::polymorphic_allocator<Double> doubleAlloc{ resource };
         std::vector<std::shared_ptr<Base>> result(0);
-        result.reserve(sz);
-        for (size_t idx = 0; idx != sz; ++idx)
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
         {
-                if (idx % 2 == 0)
+                if (kinds[idx] == Kind::Int)
                 {
                         result.push_back(std::allocate_shared<Int>(intAlloc, idx));
                 }
@@ -73,14 +152,18 @@ static std::vector<std::shared_ptr<Base> > makePolyPmrSharedVector(std::pmr::mem
         }
         return result;
 }
-static std::vector<Base*> makePolyPmrRawVector(std::pmr::memory_resource* resource, size_t sz)
+static std::vector<std::shared_ptr<Base> > makePolyPmrSharedVector(std::pmr::memory_resource* resource, size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makePolyPmrSharedVector(resource, makeKindSequence(sz, mix));
+}
+static std::vector<Base*> makePolyPmrRawVector(std::pmr::memory_resource* resource, const std::vector<Kind>& kinds)
 {
         std::pmr::polymorphic_allocator alloc{ resource };
         std::vector<Base*> result(0);
-        result.reserve(sz);
-        for (size_t idx = 0; idx != sz; ++idx)
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
         {
-                if (idx % 2 == 0)
+                if (kinds[idx] == Kind::Int)
                 {
                         result.push_back(alloc.new_object<Int>(idx));
                 }
@@ -91,15 +174,19 @@ static std::vector<Base*> makePolyPmrRawVector(std::pmr::memory_resource* resour
         }
         return result;
 }
+static std::vector<Base*> makePolyPmrRawVector(std::pmr::memory_resource* resource, size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makePolyPmrRawVector(resource, makeKindSequence(sz, mix));
+}
 
 
-static std::vector<std::variant<Int,Double> > makeVariantVector(size_t sz)
+static std::vector<std::variant<Int,Double> > makeVariantVector(const std::vector<Kind>& kinds)
 {
         std::vector<std::variant<Int, Double> > result;
-        result.reserve(sz);
-        for (size_t idx = 0; idx != sz; ++idx)
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
         {
-                if (idx % 2 == 0)
+                if (kinds[idx] == Kind::Int)
                 {
                         result.push_back(Int(idx));
                 }
@@ -110,13 +197,474 @@ static std::vector<std::variant<Int,Double> > makeVariantVector(size_t sz)
         }
         return result;
 }
+static std::vector<std::variant<Int,Double> > makeVariantVector(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makeVariantVector(makeKindSequence(sz, mix));
+}
+
+
+// poly_collection style container, one contiguous segment per concrete type.
+// iteration walks segment by segment so the visitor is statically dispatched
+// and never has to branch on the type of the element
+template<class... Ts>
+class PolyCollection
+{
+public:
+        template<class T, class... Args>
+        T& emplace(Args&&... args)
+        {
+                return segment<T>().emplace_back(std::forward<Args>(args)...);
+        }
+        template<class T>
+        std::vector<T>& segment() { return std::get<std::vector<T>>(segments_); }
+        template<class T>
+        const std::vector<T>& segment()const { return std::get<std::vector<T>>(segments_); }
+
+        template<class T>
+        void reserve(size_t sz) { segment<T>().reserve(sz); }
+
+        size_t size()const
+        {
+                return std::apply([](const auto&... seg) { return (size_t{ 0 } + ... + seg.size()); }, segments_);
+        }
+
+        template<class F>
+        void for_each(F&& f)const
+        {
+                std::apply([&](const auto&... seg) { (..., for_each_segment(seg, f)); }, segments_);
+        }
+private:
+        template<class T, class F>
+        static void for_each_segment(const std::vector<T>& seg, F& f)
+        {
+                for (const T& x : seg)
+                {
+                        f(x);
+                }
+        }
+
+        std::tuple<std::vector<Ts>...> segments_;
+};
+
+static PolyCollection<Int, Double> makePolyCollection(const std::vector<Kind>& kinds)
+{
+        PolyCollection<Int, Double> result;
+        result.reserve<Int>(std::count(kinds.begin(), kinds.end(), Kind::Int));
+        result.reserve<Double>(std::count(kinds.begin(), kinds.end(), Kind::Double));
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
+        {
+                if (kinds[idx] == Kind::Int)
+                {
+                        result.emplace<Int>(idx);
+                }
+                else
+                {
+                        result.emplace<Double>(static_cast<double>(idx));
+                }
+        }
+        return result;
+}
+static PolyCollection<Int, Double> makePolyCollection(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makePolyCollection(makeKindSequence(sz, mix));
+}
+
+
+// compact tagged union over trivially copyable payloads with a one byte
+// index, visited through a jump table built per visitor type rather than
+// relying on whatever std::visit codegen the standard library produces
+template<class T, class... Ts>
+struct IndexOf;
+template<class T, class... Rest>
+struct IndexOf<T, T, Rest...> : std::integral_constant<size_t, 0> {};
+template<class T, class U, class... Rest>
+struct IndexOf<T, U, Rest...> : std::integral_constant<size_t, 1 + IndexOf<T, Rest...>::value> {};
+
+template<class... Ts>
+class CompactVariant
+{
+        static_assert(sizeof...(Ts) <= 256, "index must fit in one byte");
+        static_assert((... && std::is_trivially_copyable_v<Ts>), "payloads must be trivially copyable");
+public:
+        template<class T, class = std::enable_if_t<(... || std::is_same_v<std::decay_t<T>, Ts>)> >
+        CompactVariant(const T& x)
+                : index_{ static_cast<uint8_t>(IndexOf<T, Ts...>::value) }
+        {
+                std::memcpy(storage_, &x, sizeof(T));
+        }
+        size_t index()const { return index_; }
+        const void* data()const { return storage_; }
+private:
+        alignas(Ts...) std::byte storage_[std::max({ sizeof(Ts)... })];
+        uint8_t index_;
+};
+
+template<class T, class F>
+decltype(auto) invokeAlternative(F& f, const void* ptr)
+{
+        return f(*static_cast<const T*>(ptr));
+}
+
+template<class F, class T0, class... Ts>
+decltype(auto) visit(F&& f, const CompactVariant<T0, Ts...>& v)
+{
+        using Result = decltype(f(std::declval<const T0&>()));
+        using Entry = Result(*)(F&, const void*);
+        static constexpr Entry table[] = { &invokeAlternative<T0, F>, &invokeAlternative<Ts, F>... };
+        return table[v.index()](f, v.data());
+}
+
+struct IntValue
+{
+        size_t value;
+};
+struct DoubleValue
+{
+        double value;
+};
+
+static std::vector<CompactVariant<IntValue, DoubleValue> > makeCompactVariantVector(const std::vector<Kind>& kinds)
+{
+        std::vector<CompactVariant<IntValue, DoubleValue> > result;
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
+        {
+                if (kinds[idx] == Kind::Int)
+                {
+                        result.push_back(IntValue{ idx });
+                }
+                else
+                {
+                        result.push_back(DoubleValue{ static_cast<double>(idx) });
+                }
+        }
+        return result;
+}
+static std::vector<CompactVariant<IntValue, DoubleValue> > makeCompactVariantVector(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makeCompactVariantVector(makeKindSequence(sz, mix));
+}
+
+// generated alternatives for measuring how dispatch scales with the number
+// of types, each one does something slightly different so the branches
+// can't be merged
+template<size_t I>
+struct Alternative
+{
+        static constexpr size_t index = I;
+        double value;
+};
+
+template<class Variant, size_t... I>
+Variant makeAlternative(size_t which, double value, std::index_sequence<I...>)
+{
+        using Factory = Variant(*)(double);
+        static constexpr Factory table[] = { [](double x) -> Variant { return Alternative<I>{ x }; }... };
+        return table[which](value);
+}
+
+template<size_t... I>
+auto makeStdVariantOf(std::index_sequence<I...>) -> std::variant<Alternative<I>...>;
+template<size_t... I>
+auto makeCompactVariantOf(std::index_sequence<I...>) -> CompactVariant<Alternative<I>...>;
+
+template<size_t N>
+using StdVariantOf = decltype(makeStdVariantOf(std::make_index_sequence<N>{}));
+template<size_t N>
+using CompactVariantOf = decltype(makeCompactVariantOf(std::make_index_sequence<N>{}));
+
+template<class Variant, size_t N>
+std::vector<Variant> makeAlternativesVector(size_t sz)
+{
+        std::mt19937 g(42);
+        std::uniform_int_distribution<size_t> which(0, N - 1);
+        std::vector<Variant> result;
+        result.reserve(sz);
+        for (size_t idx = 0; idx != sz; ++idx)
+        {
+                result.push_back(makeAlternative<Variant>(which(g), static_cast<double>(idx), std::make_index_sequence<N>{}));
+        }
+        return result;
+}
+
+struct AlternativeVisitor
+{
+        template<size_t I>
+        double operator()(const Alternative<I>& x)const
+        {
+                return x.value * static_cast<double>(I + 1) + static_cast<double>(I);
+        }
+};
+
+
+// type erased value with inline storage and a hand written vtable instead of
+// shared_ptr<Base>, so a vector of them is one contiguous block with no
+// control block or extra indirection. move only, and anything stored must
+// fit the buffer, which is sized for Int/Double
+class SboValue
+{
+public:
+        static constexpr size_t BufferSize = std::max(sizeof(Int), sizeof(Double));
+
+        template<class T, class = std::enable_if_t<!std::is_same_v<std::decay_t<T>, SboValue> > >
+        explicit SboValue(T&& x)
+        {
+                using U = std::decay_t<T>;
+                static_assert(sizeof(U) <= BufferSize && alignof(U) <= alignof(std::max_align_t), "doesn't fit small buffer");
+                static_assert(std::is_nothrow_move_constructible_v<U>, "moves must not throw");
+                new (storage_) U(std::forward<T>(x));
+                vtable_ = &vtableFor<U>;
+        }
+        SboValue(SboValue&& that) noexcept
+                : vtable_{ that.vtable_ }
+        {
+                vtable_->move(storage_, that.storage_);
+        }
+        SboValue& operator=(SboValue&& that) noexcept
+        {
+                if (this != &that)
+                {
+                        vtable_->destroy(storage_);
+                        vtable_ = that.vtable_;
+                        vtable_->move(storage_, that.storage_);
+                }
+                return *this;
+        }
+        SboValue(const SboValue&) = delete;
+        SboValue& operator=(const SboValue&) = delete;
+        ~SboValue()
+        {
+                vtable_->destroy(storage_);
+        }
+
+        double value()const { return vtable_->value(storage_); }
+private:
+        struct VTable
+        {
+                void(*destroy)(void*) noexcept;
+                void(*move)(void* dst, void* src) noexcept;
+                double(*value)(const void*);
+        };
+
+        template<class T>
+        static constexpr VTable vtableFor{
+                [](void* ptr) noexcept { static_cast<T*>(ptr)->~T(); },
+                [](void* dst, void* src) noexcept { new (dst) T(std::move(*static_cast<T*>(src))); },
+                [](const void* ptr) { return static_cast<double>(static_cast<const T*>(ptr)->value); },
+        };
+
+        alignas(std::max_align_t) std::byte storage_[BufferSize];
+        const VTable* vtable_;
+};
+
+static std::vector<SboValue> makeSboVector(const std::vector<Kind>& kinds)
+{
+        std::vector<SboValue> result;
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
+        {
+                if (kinds[idx] == Kind::Int)
+                {
+                        result.emplace_back(Int(idx));
+                }
+                else
+                {
+                        result.emplace_back(Double(static_cast<double>(idx)));
+                }
+        }
+        return result;
+}
+static std::vector<SboValue> makeSboVector(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makeSboVector(makeKindSequence(sz, mix));
+}
+
+// NaN boxed dynamic value in 8 bytes. doubles are stored as themselves with
+// NaNs canonicalised, integers live in the 48 bit payload of a NaN pattern
+// that arithmetic never produces. integers must fit in 48 signed bits
+class NanBoxed
+{
+public:
+        static NanBoxed fromInt(int64_t x)
+        {
+                return NanBoxed{ IntTag | (static_cast<uint64_t>(x) & PayloadMask) };
+        }
+        static NanBoxed fromDouble(double x)
+        {
+                return NanBoxed{ x != x ? CanonicalNaN : std::bit_cast<uint64_t>(x) };
+        }
+
+        bool isInt()const { return (bits_ & TagMask) == IntTag; }
+        int64_t asInt()const { return static_cast<int64_t>(((bits_ & PayloadMask) ^ PayloadSign) - PayloadSign); }
+        double asDouble()const { return std::bit_cast<double>(bits_); }
+
+        // computes both interpretations and selects with a mask, so it stays
+        // branch free and vectorises. the int conversion uses the 1.5*2^52
+        // trick as AVX2 has neither int64 to double nor 64 bit arithmetic shift
+        double toDouble()const
+        {
+                const uint64_t mask = 0 - static_cast<uint64_t>(isInt());
+                const uint64_t intBits = ((bits_ & PayloadMask) ^ PayloadSign) + (MagicBits - PayloadSign);
+                const uint64_t selected = (intBits & mask) | (bits_ & ~mask);
+                return std::bit_cast<double>(selected) - std::bit_cast<double>(MagicBits & mask);
+        }
+private:
+        explicit NanBoxed(uint64_t bits) : bits_{ bits } {}
+
+        static constexpr uint64_t TagMask = 0xFFFF000000000000ull;
+        static constexpr uint64_t IntTag = 0xFFF9000000000000ull;
+        static constexpr uint64_t PayloadMask = 0x0000FFFFFFFFFFFFull;
+        static constexpr uint64_t PayloadSign = 0x0000800000000000ull;
+        static constexpr uint64_t CanonicalNaN = 0x7FF8000000000000ull;
+        // bit pattern of 1.5*2^52
+        static constexpr uint64_t MagicBits = 0x4338000000000000ull;
+
+        uint64_t bits_;
+};
+static_assert(sizeof(NanBoxed) == 8, "NanBoxed must be 8 bytes");
+
+// independent accumulators so the reduction vectorises without -ffast-math
+CB_NOINLINE double sumNanBoxed(const NanBoxed* values, size_t size)
+{
+        constexpr size_t Lanes = 8;
+        double acc[Lanes] = {};
+        size_t idx = 0;
+        for (; idx + Lanes <= size; idx += Lanes)
+        {
+                for (size_t lane = 0; lane != Lanes; ++lane)
+                {
+                        acc[lane] += values[idx + lane].toDouble();
+                }
+        }
+        double sum = 0.0;
+        for (; idx != size; ++idx)
+        {
+                sum += values[idx].toDouble();
+        }
+        for (size_t lane = 0; lane != Lanes; ++lane)
+        {
+                sum += acc[lane];
+        }
+        return sum;
+}
+
+static std::vector<NanBoxed> makeNanBoxedVector(const std::vector<Kind>& kinds)
+{
+        std::vector<NanBoxed> result;
+        result.reserve(kinds.size());
+        for (size_t idx = 0; idx != kinds.size(); ++idx)
+        {
+                if (kinds[idx] == Kind::Int)
+                {
+                        result.push_back(NanBoxed::fromInt(static_cast<int64_t>(idx)));
+                }
+                else
+                {
+                        result.push_back(NanBoxed::fromDouble(static_cast<double>(idx)));
+                }
+        }
+        return result;
+}
+static std::vector<NanBoxed> makeNanBoxedVector(size_t sz, TypeMix mix = TypeMix::Alternating)
+{
+        return makeNanBoxedVector(makeKindSequence(sz, mix));
+}
+
+// partitions a vector<Base*> by kind once so each later pass is one tight
+// loop per kind with no per element branch. the permutation maps a batched
+// position back to its original index, for when results must keep order
+class KindBatches
+{
+public:
+        explicit KindBatches(const std::vector<Base*>& V, bool keepPermutation)
+        {
+                std::array<size_t, KindCount> counts{};
+                for (Base* ptr : V)
+                {
+                        ++counts[static_cast<size_t>(ptr->kind)];
+                }
+                for (size_t k = 0; k != KindCount; ++k)
+                {
+                        batches_[k].reserve(counts[k]);
+                        if (keepPermutation)
+                        {
+                                permutation_[k].reserve(counts[k]);
+                        }
+                }
+                for (size_t idx = 0; idx != V.size(); ++idx)
+                {
+                        const auto k = static_cast<size_t>(V[idx]->kind);
+                        batches_[k].push_back(V[idx]);
+                        if (keepPermutation)
+                        {
+                                permutation_[k].push_back(idx);
+                        }
+                }
+        }
+
+        template<class F>
+        void for_each(F&& f)const
+        {
+                for (Base* ptr : batches_[static_cast<size_t>(Kind::Int)])
+                {
+                        f(*static_cast<const Int*>(ptr));
+                }
+                for (Base* ptr : batches_[static_cast<size_t>(Kind::Double)])
+                {
+                        f(*static_cast<const Double*>(ptr));
+                }
+        }
+
+        // f(originalIndex, obj), requires keepPermutation
+        template<class F>
+        void for_each_indexed(F&& f)const
+        {
+                forEachIndexedImpl<Int>(Kind::Int, f);
+                forEachIndexedImpl<Double>(Kind::Double, f);
+        }
+private:
+        static constexpr size_t KindCount = 2;
+
+        template<class T, class F>
+        void forEachIndexedImpl(Kind kind, F& f)const
+        {
+                const auto& batch = batches_[static_cast<size_t>(kind)];
+                const auto& permutation = permutation_[static_cast<size_t>(kind)];
+                for (size_t pos = 0; pos != batch.size(); ++pos)
+                {
+                        f(permutation[pos], *static_cast<const T*>(batch[pos]));
+                }
+        }
+
+        std::array<std::vector<Base*>, KindCount> batches_;
+        std::array<std::vector<size_t>, KindCount> permutation_;
+};
+
+static void BatchPassSizes(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "sz", "passes", "ordered" })->ArgsProduct({
+                { 1 << 10, 1 << 14, 1 << 18, 1 << 21 },
+                { 1, 2, 4, 16 },
+                { 0, 1 } });
+}
+
+static void PolySizes(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "sz", "mix" })->ArgsProduct({
+                { 2 << 5, 2 << 10, 1 << 16, 1 << 20, 1 << 24 },
+                { static_cast<int64_t>(TypeMix::Alternating),
+                  static_cast<int64_t>(TypeMix::Uniform),
+                  static_cast<int64_t>(TypeMix::Skewed),
+                  static_cast<int64_t>(TypeMix::Runs) } });
+}
 
 static void VariantVectorVisit(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto V = makeVariantVector(sz);
+                auto V = makeVariantVector(sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const auto& v : V)
@@ -125,12 +673,15 @@ static void VariantVectorVisit(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.counters["bytes_per_elem"] = sizeof(std::variant<Int, Double>);
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(VariantVectorVisit)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(VariantVectorVisit)->Apply(PolySizes);
 
 
 static void makePolyPmrSharedVector(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         constexpr size_t buffer_size = 1024 * 1024 * 16;
         std::vector<std::byte> buf(buffer_size);
@@ -139,8 +690,8 @@ static void makePolyPmrSharedVector(benchmark::State& state) {
 
         for (auto _ : state) {
                 state.PauseTiming();
-                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size(), std::pmr::null_memory_resource() };
-                auto V = makePolyPmrSharedVector(&resource, sz);
+                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size() };
+                auto V = makePolyPmrSharedVector(&resource, sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const auto& ptr : V)
@@ -160,11 +711,13 @@ static void makePolyPmrSharedVector(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(makePolyPmrSharedVector)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(makePolyPmrSharedVector)->Apply(PolySizes);
 
 static void makePolyPmrRawVector(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         constexpr size_t buffer_size = 1024 * 1024 * 16;
         std::vector<std::byte> buf(buffer_size);
@@ -173,8 +726,8 @@ static void makePolyPmrRawVector(benchmark::State& state) {
 
         for (auto _ : state) {
                 state.PauseTiming();
-                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size(), std::pmr::null_memory_resource() };
-                auto V = makePolyPmrRawVector(&resource, sz);
+                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size() };
+                auto V = makePolyPmrRawVector(&resource, sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const auto& ptr : V)
@@ -194,11 +747,13 @@ static void makePolyPmrRawVector(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(makePolyPmrRawVector)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(makePolyPmrRawVector)->Apply(PolySizes);
 
 static void makePolyPmrRawVectorTypeSwitch(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         constexpr size_t buffer_size = 1024 * 1024 * 16;
         std::vector<std::byte> buf(buffer_size);
@@ -207,8 +762,8 @@ static void makePolyPmrRawVectorTypeSwitch(benchmark::State& state) {
 
         for (auto _ : state) {
                 state.PauseTiming();
-                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size(), std::pmr::null_memory_resource() };
-                auto V = makePolyPmrRawVector(&resource, sz);
+                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size() };
+                auto V = makePolyPmrRawVector(&resource, sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (Base* ptr : V)
@@ -227,16 +782,18 @@ static void makePolyPmrRawVectorTypeSwitch(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(makePolyPmrRawVectorTypeSwitch)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(makePolyPmrRawVectorTypeSwitch)->Apply(PolySizes);
 
 
 static void PolyVector(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto V = makePolyVector(sz);
+                auto V = makePolyVector(sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const auto& ptr : V)
@@ -256,15 +813,17 @@ static void PolyVector(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(PolyVector)->RangeMultiplier(2)->Range(2<<5,2<<10);
+BENCHMARK(PolyVector)->Apply(PolySizes);
 
 static void PolyVectorTypeSwitch(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto V = makePolyVector(sz);
+                auto V = makePolyVector(sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const std::shared_ptr<Base>& ptr : V)
@@ -283,17 +842,19 @@ static void PolyVectorTypeSwitch(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(PolyVectorTypeSwitch)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PolyVectorTypeSwitch)->Apply(PolySizes);
 
 
 
 static void VariantVector(benchmark::State& state) {
         const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
         for (auto _ : state) {
                 state.PauseTiming();
-                auto V = makeVariantVector(sz);
+                auto V = makeVariantVector(sz, mix);
                 state.ResumeTiming();
                 double sum = 0.0;
                 for (const auto& v : V)
@@ -313,14 +874,374 @@ static void VariantVector(benchmark::State& state) {
                 }
                 benchmark::DoNotOptimize(sum);
         }
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(VariantVector)->Apply(PolySizes);
+
+
+static void PolyCollectionVisit(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto C = makePolyCollection(sz, mix);
+                state.ResumeTiming();
+                double sum = 0.0;
+                C.for_each([&](const auto& x) { sum += static_cast<double>(x.value); });
+                benchmark::DoNotOptimize(sum);
+        }
+        state.SetLabel(toString(mix));
 }
-BENCHMARK(VariantVector)->RangeMultiplier(2)->Range(2 << 5, 2 << 10);
+BENCHMARK(PolyCollectionVisit)->Apply(PolySizes);
 
 
+static void CompactVariantVisit(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
 
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto V = makeCompactVariantVector(sz, mix);
+                state.ResumeTiming();
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        sum += visit([](const auto& arg) -> double {return static_cast<double>(arg.value); }, v);
+                }
+                benchmark::DoNotOptimize(sum);
+        }
+        state.counters["bytes_per_elem"] = sizeof(CompactVariant<IntValue, DoubleValue>);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(CompactVariantVisit)->Apply(PolySizes);
+
+template<size_t N>
+static void StdVariantAlternatives(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto V = makeAlternativesVector<StdVariantOf<N>, N>(sz);
 
+        for (auto _ : state) {
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        sum += std::visit(AlternativeVisitor{}, v);
+                }
+                benchmark::DoNotOptimize(sum);
+        }
+        state.counters["bytes_per_elem"] = sizeof(StdVariantOf<N>);
+        state.SetItemsProcessed(state.iterations() * sz);
+}
+BENCHMARK_TEMPLATE(StdVariantAlternatives, 2)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(StdVariantAlternatives, 4)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(StdVariantAlternatives, 8)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(StdVariantAlternatives, 16)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(StdVariantAlternatives, 32)->Arg(1 << 16);
+
+template<size_t N>
+static void CompactVariantAlternatives(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto V = makeAlternativesVector<CompactVariantOf<N>, N>(sz);
+
+        for (auto _ : state) {
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        sum += visit(AlternativeVisitor{}, v);
+                }
+                benchmark::DoNotOptimize(sum);
+        }
+        state.counters["bytes_per_elem"] = sizeof(CompactVariantOf<N>);
+        state.SetItemsProcessed(state.iterations() * sz);
+}
+BENCHMARK_TEMPLATE(CompactVariantAlternatives, 2)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(CompactVariantAlternatives, 4)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(CompactVariantAlternatives, 8)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(CompactVariantAlternatives, 16)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(CompactVariantAlternatives, 32)->Arg(1 << 16);
+
+
+// uses a uniform random kind sequence, that's the case where a per element
+// switch costs something. ordered=1 writes a result per element in original
+// order instead of reducing to a sum
+static void RawVectorTypeSwitchPasses(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto passes = state.range(1);
+        const bool ordered = state.range(2) != 0;
+
+        std::pmr::monotonic_buffer_resource resource;
+        auto V = makePolyPmrRawVector(&resource, sz, TypeMix::Uniform);
+        std::vector<double> out(sz);
+
+        for (auto _ : state) {
+                double sum = 0.0;
+                for (int64_t pass = 0; pass != passes; ++pass)
+                {
+                        for (size_t idx = 0; idx != V.size(); ++idx)
+                        {
+                                Base* ptr = V[idx];
+                                double value;
+                                switch (ptr->kind)
+                                {
+                                case Kind::Int:
+                                        value = static_cast<double>(static_cast<Int*>(ptr)->value);
+                                        break;
+                                case Kind::Double:
+                                        value = static_cast<Double*>(ptr)->value * 0.5;
+                                        break;
+                                default:
+                                        throw std::domain_error("somethign bad");
+                                }
+                                if (ordered)
+                                {
+                                        out[idx] += value;
+                                }
+                                else
+                                {
+                                        sum += value;
+                                }
+                        }
+                }
+                benchmark::DoNotOptimize(sum);
+                benchmark::DoNotOptimize(out.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz * passes);
+}
+BENCHMARK(RawVectorTypeSwitchPasses)->Apply(BatchPassSizes);
+
+// same work, but the partition is built inside the timed region so its cost
+// is amortised over the passes
+static void RawVectorKindBatchedPasses(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto passes = state.range(1);
+        const bool ordered = state.range(2) != 0;
+
+        std::pmr::monotonic_buffer_resource resource;
+        auto V = makePolyPmrRawVector(&resource, sz, TypeMix::Uniform);
+        std::vector<double> out(sz);
+
+        struct Value
+        {
+                double operator()(const Int& x)const { return static_cast<double>(x.value); }
+                double operator()(const Double& x)const { return x.value * 0.5; }
+        };
+
+        for (auto _ : state) {
+                const KindBatches batches(V, ordered);
+                double sum = 0.0;
+                for (int64_t pass = 0; pass != passes; ++pass)
+                {
+                        if (ordered)
+                        {
+                                batches.for_each_indexed([&](size_t idx, const auto& x) { out[idx] += Value{}(x); });
+                        }
+                        else
+                        {
+                                batches.for_each([&](const auto& x) { sum += Value{}(x); });
+                        }
+                }
+                benchmark::DoNotOptimize(sum);
+                benchmark::DoNotOptimize(out.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz * passes);
+}
+BENCHMARK(RawVectorKindBatchedPasses)->Apply(BatchPassSizes);
 
 
 
-BENCHMARK_MAIN();
 
+
+
+
+static void SboVectorVisit(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto V = makeSboVector(sz, mix);
+                state.ResumeTiming();
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        sum += v.value();
+                }
+                benchmark::DoNotOptimize(sum);
+        }
+        state.counters["bytes_per_elem"] = sizeof(SboValue);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(SboVectorVisit)->Apply(PolySizes);
+
+// construction cost, including tearing the container down again. the kind
+// sequence is generated up front so only the container work is timed
+static void PolyVectorConstruct(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto kinds = makeKindSequence(sz, mix);
+
+        for (auto _ : state) {
+                auto V = makePolyVector(kinds);
+                benchmark::DoNotOptimize(V.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(PolyVectorConstruct)->Apply(PolySizes);
+
+static void PolyPmrSharedVectorConstruct(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto kinds = makeKindSequence(sz, mix);
+
+        constexpr size_t buffer_size = 1024 * 1024 * 16;
+        std::vector<std::byte> buf(buffer_size);
+
+        for (auto _ : state) {
+                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size() };
+                auto V = makePolyPmrSharedVector(&resource, kinds);
+                benchmark::DoNotOptimize(V.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(PolyPmrSharedVectorConstruct)->Apply(PolySizes);
+
+// the buffer hands its memory back in one go, the objects in it still get
+// their destructors run like every other container here
+static void PolyPmrRawVectorConstruct(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto kinds = makeKindSequence(sz, mix);
+
+        constexpr size_t buffer_size = 1024 * 1024 * 16;
+        std::vector<std::byte> buf(buffer_size);
+
+        for (auto _ : state) {
+                std::pmr::monotonic_buffer_resource resource{ buf.data(), buf.size() };
+                auto V = makePolyPmrRawVector(&resource, kinds);
+                benchmark::DoNotOptimize(V.data());
+                for (Base* ptr : V)
+                {
+                        std::destroy_at(ptr);
+                }
+        }
+        state.SetItemsProcessed(state.iterations() * sz);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(PolyPmrRawVectorConstruct)->Apply(PolySizes);
+
+static void VariantVectorConstruct(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto kinds = makeKindSequence(sz, mix);
+
+        for (auto _ : state) {
+                auto V = makeVariantVector(kinds);
+                benchmark::DoNotOptimize(V.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(VariantVectorConstruct)->Apply(PolySizes);
+
+static void SboVectorConstruct(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto kinds = makeKindSequence(sz, mix);
+
+        for (auto _ : state) {
+                auto V = makeSboVector(kinds);
+                benchmark::DoNotOptimize(V.data());
+        }
+        state.SetItemsProcessed(state.iterations() * sz);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(SboVectorConstruct)->Apply(PolySizes);
+
+
+static void NanBoxedVisit(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto V = makeNanBoxedVector(sz, mix);
+                state.ResumeTiming();
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        if (v.isInt())
+                        {
+                                sum += v.asInt();
+                        }
+                        else
+                        {
+                                sum += v.asDouble();
+                        }
+                }
+                benchmark::DoNotOptimize(sum);
+        }
+        state.counters["bytes_per_elem"] = sizeof(NanBoxed);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(NanBoxedVisit)->Apply(PolySizes);
+
+static void NanBoxedSum(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+
+        for (auto _ : state) {
+                state.PauseTiming();
+                auto V = makeNanBoxedVector(sz, mix);
+                state.ResumeTiming();
+                benchmark::DoNotOptimize(sumNanBoxed(V.data(), V.size()));
+        }
+        state.counters["bytes_per_elem"] = sizeof(NanBoxed);
+        state.SetLabel(toString(mix));
+}
+BENCHMARK(NanBoxedSum)->Apply(PolySizes);
+
+// every visit timed on its own, see cb_latency.h
+static void VariantVectorVisitLatency(benchmark::State& state) {
+        const auto sz = state.range(0);
+        const auto mix = static_cast<TypeMix>(state.range(1));
+        const auto V = makeVariantVector(sz, mix);
+        LatencyHistogram histogram;
+
+        for (auto _ : state) {
+                double sum = 0.0;
+                for (const auto& v : V)
+                {
+                        timeOperation(histogram, [&]() {
+                                sum += std::visit([](auto&& arg) -> double {return static_cast<double>(arg.value); }, v);
+                                benchmark::DoNotOptimize(sum); });
+                }
+        }
+        state.SetLabel(toString(mix));
+        reportLatency(state, histogram, std::string("VariantVectorVisit/") + std::to_string(sz) + "/" + toString(mix));
+}
+
+static void registerLatencyBenchmarks()
+{
+        benchmark::RegisterBenchmark("VariantVectorVisitLatency", VariantVectorVisitLatency)->Apply(PolySizes);
+}
+
+// branch and cache misses are reported by default, the type mixes only differ
+// in how predictable they are.
+// --latency_histograms[=file] adds the per visit latency benchmark
+int main(int argc, char** argv)
+{
+        std::vector<char*> args(argv, argv + argc);
+        const bool latencyHistograms = takeLatencyHistogramsFlag(args);
+        if (latencyHistograms)
+        {
+                registerLatencyBenchmarks();
+        }
+        const int result = runWithPerfCounters(args, "BRANCH-MISSES,CACHE-MISSES");
+        if (result == 0 && latencyHistograms)
+        {
+                writeLatencyDump();
+        }
+        return result;
+}
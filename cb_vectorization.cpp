@@ -10,6 +10,34 @@
 #include <iterator>
 #include <array>
 #include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <cmath>
+#include <limits>
+#include <xmmintrin.h>
+
+#include "cb_aligned_allocator.h"
+
+constexpr size_t KernelAlignment = 64;
+
+using AlignedVector = std::vector<double, AlignedAllocator<double, KernelAlignment> >;
+
+// only legal to pass Aligned=true for storage coming from AlignedVector
+template<bool Aligned, class T>
+T* assumeKernelAligned(T* ptr)
+{
+        if constexpr (Aligned)
+        {
+                return std::assume_aligned<KernelAlignment>(ptr);
+        }
+        else
+        {
+                return ptr;
+        }
+}
+
+template<bool Aligned>
+using KernelStorage = std::conditional_t<Aligned, AlignedVector, std::vector<double> >;
 
 __declspec(noinline) void vectorAdd(
         std::vector<double>& out,
@@ -115,6 +143,249 @@ __declspec(noinline) void vectorMullAddMullAdd(
 
 
 
+// same kernels as above, but the caller promises no aliasing, and optionally
+// 64 byte alignment, so the compiler doesn't need overlap checks or peeling
+template<bool Aligned>
+__declspec(noinline) void vectorAddRestrict(
+        size_t size,
+        double* __restrict out,
+        const double* __restrict A,
+        const double* __restrict B)
+{
+        out = assumeKernelAligned<Aligned>(out);
+        A = assumeKernelAligned<Aligned>(A);
+        B = assumeKernelAligned<Aligned>(B);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                out[idx] = A[idx] + B[idx];
+        }
+}
+
+template<bool Aligned>
+__declspec(noinline) void vectorMulRestrict(
+        size_t size,
+        double* __restrict out,
+        const double* __restrict A,
+        const double* __restrict B)
+{
+        out = assumeKernelAligned<Aligned>(out);
+        A = assumeKernelAligned<Aligned>(A);
+        B = assumeKernelAligned<Aligned>(B);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                out[idx] = A[idx] * B[idx];
+        }
+}
+
+template<bool Aligned>
+__declspec(noinline) void vectorInplaceAddRestrict(
+        size_t size,
+        double* __restrict LP,
+        const double* __restrict RP)
+{
+        LP = assumeKernelAligned<Aligned>(LP);
+        RP = assumeKernelAligned<Aligned>(RP);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                LP[idx] += RP[idx];
+        }
+}
+
+template<bool Aligned>
+__declspec(noinline) void vectorInplaceMulRestrict(
+        size_t size,
+        double* __restrict LP,
+        const double* __restrict RP)
+{
+        LP = assumeKernelAligned<Aligned>(LP);
+        RP = assumeKernelAligned<Aligned>(RP);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                LP[idx] *= RP[idx];
+        }
+}
+
+template<bool Aligned>
+__declspec(noinline) void vectorMullAddRestrict(
+        size_t size,
+        double* __restrict out,
+        const double* __restrict A,
+        const double* __restrict B,
+        const double* __restrict C)
+{
+        out = assumeKernelAligned<Aligned>(out);
+        A = assumeKernelAligned<Aligned>(A);
+        B = assumeKernelAligned<Aligned>(B);
+        C = assumeKernelAligned<Aligned>(C);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                out[idx] = A[idx] * B[idx] + C[idx];
+        }
+}
+
+template<bool Aligned>
+__declspec(noinline) void vectorMullAddMullAddRestrict(
+        size_t size,
+        double* __restrict out,
+        const double* __restrict A,
+        const double* __restrict B,
+        const double* __restrict C,
+        const double* __restrict D,
+        const double* __restrict E)
+{
+        out = assumeKernelAligned<Aligned>(out);
+        A = assumeKernelAligned<Aligned>(A);
+        B = assumeKernelAligned<Aligned>(B);
+        C = assumeKernelAligned<Aligned>(C);
+        D = assumeKernelAligned<Aligned>(D);
+        E = assumeKernelAligned<Aligned>(E);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                out[idx] = (A[idx] * B[idx] + C[idx]) * D[idx] + E[idx];
+        }
+}
+
+
+
+
+
+// per element cost of each kernel, used to place it on the roofline. bytes
+// counts every load and store once, ignoring write allocate traffic
+struct KernelCost
+{
+        double flops;
+        double bytes;
+};
+constexpr KernelCost operator+(const KernelCost& l, const KernelCost& r)
+{
+        return KernelCost{ l.flops + r.flops, l.bytes + r.bytes };
+}
+
+// nominal cost of a libm log, only so the log kernels can be plotted at all
+constexpr double LogFlops = 20.0;
+
+constexpr KernelCost AddCost{ 1.0, 3 * sizeof(double) };
+constexpr KernelCost MulCost{ 1.0, 3 * sizeof(double) };
+constexpr KernelCost LogCost{ LogFlops, 2 * sizeof(double) };
+constexpr KernelCost InplaceAddCost{ 1.0, 3 * sizeof(double) };
+constexpr KernelCost InplaceMulCost{ 1.0, 3 * sizeof(double) };
+constexpr KernelCost InplaceLogCost{ LogFlops, 2 * sizeof(double) };
+constexpr KernelCost MulAddCost{ 2.0, 4 * sizeof(double) };
+constexpr KernelCost LogMulAddCost{ 2.0 + LogFlops, 4 * sizeof(double) };
+constexpr KernelCost MulAddMulAddCost{ 4.0, 6 * sizeof(double) };
+
+static void setRooflineCounters(benchmark::State& state, const KernelCost& cost, int64_t size)
+{
+        const double elements = static_cast<double>(state.iterations()) * static_cast<double>(size);
+        state.counters["FLOP/s"] = benchmark::Counter(cost.flops * elements, benchmark::Counter::kIsRate);
+        state.counters["bytes/s"] = benchmark::Counter(cost.bytes * elements, benchmark::Counter::kIsRate);
+        state.counters["AI"] = cost.flops / cost.bytes;
+}
+
+static void KernelSizes(benchmark::internal::Benchmark* b)
+{
+        // from L1 resident up to well past the LLC
+        b->RangeMultiplier(8)->Range(1 << 9, 1 << 22);
+}
+
+enum class InputDistribution
+{
+        Zero,
+        Uniform,
+        LogNormal,
+        Subnormal,
+};
+
+static const char* toString(InputDistribution dist)
+{
+        switch (dist)
+        {
+        case InputDistribution::Zero: return "zero";
+        case InputDistribution::Uniform: return "uniform";
+        case InputDistribution::LogNormal: return "lognormal";
+        case InputDistribution::Subnormal: return "subnormal";
+        default:
+                throw std::domain_error("unknown distribution");
+        }
+}
+
+// Subnormal is half subnormal values and half in [0.5,1), so products of
+// two inputs mostly land in the subnormal range as well
+template<class VectorType>
+void fillInputs(VectorType& X, InputDistribution dist, unsigned seed)
+{
+        std::mt19937_64 g(seed);
+        std::uniform_real_distribution<double> uniform(0.5, 2.0);
+        std::lognormal_distribution<double> lognormal(0.0, 2.0);
+        std::uniform_real_distribution<double> mantissa(0.0, 1.0);
+        for (auto& x : X)
+        {
+                switch (dist)
+                {
+                case InputDistribution::Zero:
+                        x = 0.0;
+                        break;
+                case InputDistribution::Uniform:
+                        x = uniform(g);
+                        break;
+                case InputDistribution::LogNormal:
+                        x = lognormal(g);
+                        break;
+                case InputDistribution::Subnormal:
+                        if (g() % 2 == 0)
+                        {
+                                x = std::numeric_limits<double>::denorm_min() + mantissa(g) * std::numeric_limits<double>::min();
+                        }
+                        else
+                        {
+                                x = 0.5 + mantissa(g) * 0.5;
+                        }
+                        break;
+                }
+        }
+}
+
+template<class VectorType>
+double subnormalFraction(const VectorType& X)
+{
+        const auto count = std::count_if(X.begin(), X.end(), [](double x) { return std::fpclassify(x) == FP_SUBNORMAL; });
+        return X.empty() ? 0.0 : static_cast<double>(count) / X.size();
+}
+
+// sets flush-to-zero and denormals-are-zero for the lifetime of the guard,
+// or explicitly clears them so a benchmark isn't affected by the global state
+class DenormalModeGuard
+{
+public:
+        explicit DenormalModeGuard(bool flushDenormals)
+                : saved_{ _mm_getcsr() }
+        {
+                constexpr unsigned FtzDaz = 0x8000 | 0x0040;
+                _mm_setcsr(flushDenormals ? (saved_ | FtzDaz) : (saved_ & ~FtzDaz));
+        }
+        ~DenormalModeGuard()
+        {
+                _mm_setcsr(saved_);
+        }
+        DenormalModeGuard(const DenormalModeGuard&) = delete;
+        DenormalModeGuard& operator=(const DenormalModeGuard&) = delete;
+private:
+        unsigned saved_;
+};
+
+static void InputSizes(benchmark::internal::Benchmark* b)
+{
+        b->ArgNames({ "dist", "ftz", "size" })->ArgsProduct({
+                { static_cast<int64_t>(InputDistribution::Zero),
+                  static_cast<int64_t>(InputDistribution::Uniform),
+                  static_cast<int64_t>(InputDistribution::LogNormal),
+                  static_cast<int64_t>(InputDistribution::Subnormal) },
+                { 0, 1 },
+                { 1 << 12, 1 << 20 } });
+}
+
+
+
 
 
 static void VectorAdd(benchmark::State& state) {
@@ -131,8 +402,9 @@ static void VectorAdd(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, AddCost, size);
 }
-BENCHMARK(VectorAdd)->Arg(64000);
+BENCHMARK(VectorAdd)->Apply(KernelSizes);
 
 static void VectorMul(benchmark::State& state) {
         const auto size = state.range(0);
@@ -148,8 +420,9 @@ static void VectorMul(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulCost, size);
 }
-BENCHMARK(VectorMul)->Arg(64000);
+BENCHMARK(VectorMul)->Apply(KernelSizes);
 
 static void VectorLog(benchmark::State& state) {
         const auto size = state.range(0);
@@ -164,8 +437,9 @@ static void VectorLog(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, LogCost, size);
 }
-BENCHMARK(VectorLog)->Arg(64000);
+BENCHMARK(VectorLog)->Apply(KernelSizes);
 
 
 
@@ -184,8 +458,9 @@ static void VectorInplaceAdd(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(A);
         }
+        setRooflineCounters(state, InplaceAddCost, size);
 }
-BENCHMARK(VectorInplaceAdd)->Arg(64000);
+BENCHMARK(VectorInplaceAdd)->Apply(KernelSizes);
 
 
 static void VectorInplaceMul(benchmark::State& state) {
@@ -202,8 +477,9 @@ static void VectorInplaceMul(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(A);
         }
+        setRooflineCounters(state, InplaceMulCost, size);
 }
-BENCHMARK(VectorInplaceMul)->Arg(64000);
+BENCHMARK(VectorInplaceMul)->Apply(KernelSizes);
 
 
 static void VectorInplaceLog(benchmark::State& state) {
@@ -218,8 +494,9 @@ static void VectorInplaceLog(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(X);
         }
+        setRooflineCounters(state, InplaceLogCost, size);
 }
-BENCHMARK(VectorInplaceLog)->Arg(64000);
+BENCHMARK(VectorInplaceLog)->Apply(KernelSizes);
 
 
 
@@ -241,8 +518,9 @@ static void VectorMulAdd(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulAddCost, size);
 }
-BENCHMARK(VectorMulAdd)->Arg(64000);
+BENCHMARK(VectorMulAdd)->Apply(KernelSizes);
 
 static void VectorMulAddSequenced(benchmark::State& state) {
         const auto size = state.range(0);
@@ -260,8 +538,9 @@ static void VectorMulAddSequenced(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulCost + InplaceAddCost, size);
 }
-BENCHMARK(VectorMulAddSequenced)->Arg(64000);
+BENCHMARK(VectorMulAddSequenced)->Apply(KernelSizes);
 
 
 static void VectorMulAddMullAdd(benchmark::State& state) {
@@ -281,8 +560,9 @@ static void VectorMulAddMullAdd(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulAddMulAddCost, size);
 }
-BENCHMARK(VectorMulAddMullAdd)->Arg(64000);
+BENCHMARK(VectorMulAddMullAdd)->Apply(KernelSizes);
 
 
 static void VectorMulAddMullAddSequenced(benchmark::State& state) {
@@ -305,8 +585,9 @@ static void VectorMulAddMullAddSequenced(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulCost + InplaceAddCost + InplaceMulCost + InplaceAddCost, size);
 }
-BENCHMARK(VectorMulAddMullAddSequenced)->Arg(64000);
+BENCHMARK(VectorMulAddMullAddSequenced)->Apply(KernelSizes);
 
 
 
@@ -327,8 +608,9 @@ static void VectorLogMulAdd(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, LogMulAddCost, size);
 }
-BENCHMARK(VectorLogMulAdd)->Arg(64000);
+BENCHMARK(VectorLogMulAdd)->Apply(KernelSizes);
 
 static void VectorLogMulAddSequenced(benchmark::State& state) {
         const auto size = state.range(0);
@@ -347,11 +629,318 @@ static void VectorLogMulAddSequenced(benchmark::State& state) {
 
                 benchmark::DoNotOptimize(out);
         }
+        setRooflineCounters(state, MulCost + InplaceAddCost + InplaceLogCost, size);
 }
-BENCHMARK(VectorLogMulAddSequenced)->Arg(64000);
+BENCHMARK(VectorLogMulAddSequenced)->Apply(KernelSizes);
 
 
 
+template<bool Aligned>
+static void VectorAddRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> out(size);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+
+        for (auto _ : state) {
+
+                vectorAddRestrict<Aligned>(size, out.data(), A.data(), B.data());
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, AddCost, size);
+}
+BENCHMARK_TEMPLATE(VectorAddRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorAddRestrict, true)->Apply(KernelSizes);
+
+template<bool Aligned>
+static void VectorMulRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> out(size);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+
+        for (auto _ : state) {
+
+                vectorMulRestrict<Aligned>(size, out.data(), A.data(), B.data());
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulCost, size);
+}
+BENCHMARK_TEMPLATE(VectorMulRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorMulRestrict, true)->Apply(KernelSizes);
+
+template<bool Aligned>
+static void VectorInplaceAddRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+
+        for (auto _ : state) {
+
+                vectorInplaceAddRestrict<Aligned>(size, A.data(), B.data());
+
+                benchmark::DoNotOptimize(A);
+        }
+        setRooflineCounters(state, InplaceAddCost, size);
+}
+BENCHMARK_TEMPLATE(VectorInplaceAddRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorInplaceAddRestrict, true)->Apply(KernelSizes);
+
+template<bool Aligned>
+static void VectorInplaceMulRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+
+        for (auto _ : state) {
+
+                vectorInplaceMulRestrict<Aligned>(size, A.data(), B.data());
+
+                benchmark::DoNotOptimize(A);
+        }
+        setRooflineCounters(state, InplaceMulCost, size);
+}
+BENCHMARK_TEMPLATE(VectorInplaceMulRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorInplaceMulRestrict, true)->Apply(KernelSizes);
+
+template<bool Aligned>
+static void VectorMulAddRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> out(size);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+        KernelStorage<Aligned> C(size);
+
+        for (auto _ : state) {
+
+                vectorMullAddRestrict<Aligned>(size, out.data(), A.data(), B.data(), C.data());
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulAddCost, size);
+}
+BENCHMARK_TEMPLATE(VectorMulAddRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorMulAddRestrict, true)->Apply(KernelSizes);
+
+template<bool Aligned>
+static void VectorMulAddMullAddRestrict(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        KernelStorage<Aligned> out(size);
+
+        KernelStorage<Aligned> A(size);
+        KernelStorage<Aligned> B(size);
+        KernelStorage<Aligned> C(size);
+        KernelStorage<Aligned> D(size);
+        KernelStorage<Aligned> E(size);
+
+        for (auto _ : state) {
+
+                vectorMullAddMullAddRestrict<Aligned>(size, out.data(), A.data(), B.data(), C.data(), D.data(), E.data());
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulAddMulAddCost, size);
+}
+BENCHMARK_TEMPLATE(VectorMulAddMullAddRestrict, false)->Apply(KernelSizes);
+BENCHMARK_TEMPLATE(VectorMulAddMullAddRestrict, true)->Apply(KernelSizes);
+
+
+// same kernels fed with realistic inputs, with and without FTZ/DAZ, to
+// measure the subnormal slowdown. subnormal_out is measured after the run
+static void VectorMulInputs(benchmark::State& state) {
+        const auto dist = static_cast<InputDistribution>(state.range(0));
+        const bool flushDenormals = state.range(1) != 0;
+        const auto size = state.range(2);
+
+        std::vector<double> out(size);
+
+        std::vector<double> A(size);
+        std::vector<double> B(size);
+        fillInputs(A, dist, 1);
+        fillInputs(B, dist, 2);
+
+        DenormalModeGuard guard(flushDenormals);
+        for (auto _ : state) {
+
+                vectorMul(out, A, B);
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulCost, size);
+        state.counters["subnormal_out"] = subnormalFraction(out);
+        state.SetLabel(toString(dist));
+}
+BENCHMARK(VectorMulInputs)->Apply(InputSizes);
+
+static void VectorMulAddInputs(benchmark::State& state) {
+        const auto dist = static_cast<InputDistribution>(state.range(0));
+        const bool flushDenormals = state.range(1) != 0;
+        const auto size = state.range(2);
+
+        std::vector<double> out(size);
+
+        std::vector<double> A(size);
+        std::vector<double> B(size);
+        std::vector<double> C(size);
+        fillInputs(A, dist, 1);
+        fillInputs(B, dist, 2);
+        fillInputs(C, dist, 3);
+
+        DenormalModeGuard guard(flushDenormals);
+        for (auto _ : state) {
+
+                vectorMullAdd(out, A, B, C);
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulAddCost, size);
+        state.counters["subnormal_out"] = subnormalFraction(out);
+        state.SetLabel(toString(dist));
+}
+BENCHMARK(VectorMulAddInputs)->Apply(InputSizes);
+
+static void VectorLogInputs(benchmark::State& state) {
+        const auto dist = static_cast<InputDistribution>(state.range(0));
+        const bool flushDenormals = state.range(1) != 0;
+        const auto size = state.range(2);
+
+        std::vector<double> out(size);
+
+        std::vector<double> A(size);
+        fillInputs(A, dist, 1);
+
+        DenormalModeGuard guard(flushDenormals);
+        for (auto _ : state) {
+
+                vectorLog(out, A);
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, LogCost, size);
+        state.counters["subnormal_out"] = subnormalFraction(out);
+        state.SetLabel(toString(dist));
+}
+BENCHMARK(VectorLogInputs)->Apply(InputSizes);
+
+static void VectorLogMulAddInputs(benchmark::State& state) {
+        const auto dist = static_cast<InputDistribution>(state.range(0));
+        const bool flushDenormals = state.range(1) != 0;
+        const auto size = state.range(2);
+
+        std::vector<double> out(size);
+
+        std::vector<double> A(size);
+        std::vector<double> B(size);
+        std::vector<double> C(size);
+        fillInputs(A, dist, 1);
+        fillInputs(B, dist, 2);
+        fillInputs(C, dist, 3);
+
+        DenormalModeGuard guard(flushDenormals);
+        for (auto _ : state) {
+
+                vectorLogMulAdd(out, A, B, C);
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, LogMulAddCost, size);
+        state.counters["subnormal_out"] = subnormalFraction(out);
+        state.SetLabel(toString(dist));
+}
+BENCHMARK(VectorLogMulAddInputs)->Apply(InputSizes);
+
+
+
+// machine roofline, the ceiling every kernel above is measured against.
+// peak compute uses independent multiply-add chains that live in registers,
+// peak bandwidth is the STREAM triad over arrays far larger than the LLC
+constexpr size_t PeakFlopsLanes = 48;
+
+__declspec(noinline) void peakFlopsKernel(
+        size_t rounds,
+        double* __restrict acc,
+        double m,
+        double a)
+{
+        double local[PeakFlopsLanes];
+        std::copy(acc, acc + PeakFlopsLanes, local);
+        for (size_t round = 0; round != rounds; ++round)
+        {
+                for (size_t lane = 0; lane != PeakFlopsLanes; ++lane)
+                {
+                        local[lane] = local[lane] * m + a;
+                }
+        }
+        std::copy(local, local + PeakFlopsLanes, acc);
+}
+
+static void RooflinePeakFlops(benchmark::State& state) {
+        const auto rounds = static_cast<size_t>(state.range(0));
+
+        AlignedVector acc(PeakFlopsLanes, 1.0);
+        double m = 0.999999;
+        double a = 1e-6;
+        benchmark::DoNotOptimize(m);
+        benchmark::DoNotOptimize(a);
+
+        for (auto _ : state) {
+
+                peakFlopsKernel(rounds, acc.data(), m, a);
+
+                benchmark::DoNotOptimize(acc);
+        }
+        state.counters["FLOP/s"] = benchmark::Counter(
+                2.0 * PeakFlopsLanes * static_cast<double>(rounds) * static_cast<double>(state.iterations()),
+                benchmark::Counter::kIsRate);
+}
+BENCHMARK(RooflinePeakFlops)->Arg(1 << 16);
+
+__declspec(noinline) void streamTriad(
+        size_t size,
+        double* __restrict out,
+        const double* __restrict A,
+        const double* __restrict B,
+        double scalar)
+{
+        out = assumeKernelAligned<true>(out);
+        A = assumeKernelAligned<true>(A);
+        B = assumeKernelAligned<true>(B);
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+                out[idx] = A[idx] + scalar * B[idx];
+        }
+}
+
+static void RooflineStreamTriad(benchmark::State& state) {
+        const auto size = state.range(0);
+
+        AlignedVector out(size);
+
+        AlignedVector A(size, 1.0);
+        AlignedVector B(size, 2.0);
+
+        for (auto _ : state) {
+
+                streamTriad(size, out.data(), A.data(), B.data(), 3.0);
+
+                benchmark::DoNotOptimize(out);
+        }
+        setRooflineCounters(state, MulAddCost, size);
+}
+BENCHMARK(RooflineStreamTriad)->Arg(1 << 23);
+
+
 
 
 